@@ -0,0 +1,236 @@
+"""Generates Pinky programs of a given size and shape.
+
+The program declares `--functions` functions that each nest `--depth` blocks
+of ifs, whiles and fors, compute expressions of `--width` operands and call
+the function declared before them, in chains of eight. A top level loop
+calls all of them `--trips` times, and a function recursing `--recursion`
+calls deep runs once. `--strings` is the share of statements that build and
+compare strings instead of numbers. The same options and `--seed` always
+give the same program, which prints the same numbers on every
+implementation.
+"""
+
+import argparse
+import random
+import sys
+from typing import List
+
+# Numbers are kept below this, so no implementation overflows.
+MODULUS = 1000003
+# Functions call the one declared before them in chains of this length, so
+# each runs once per trip of the top level loop.
+CHAIN = 8
+
+
+class Options:
+    def __init__(
+        self,
+        functions: int = 10,
+        depth: int = 3,
+        trips: int = 100,
+        inner_trips: int = 2,
+        width: int = 4,
+        strings: float = 0.2,
+        recursion: int = 100,
+        seed: int = 1,
+    ):
+        self.functions = functions
+        self.depth = depth
+        self.trips = trips
+        # Trip count of the loops nested in functions.
+        self.inner_trips = inner_trips
+        self.width = width
+        self.strings = strings
+        self.recursion = recursion
+        self.seed = seed
+
+
+class Generator:
+    def __init__(self, options: Options):
+        self.options = options
+        self.random = random.Random(options.seed)
+        self.lines: List[str] = []
+        self.indent = 0
+        self.labels = 0
+
+    def emit(self, line: str) -> None:
+        self.lines.append("  " * self.indent + line)
+
+    # A sum of `--width` terms over the given variables; every term is a
+    # variable, a variable times or modulo a small constant, or a constant.
+    def expression(self, names: List[str]) -> str:
+        terms = []
+        for _ in range(self.options.width):
+            name = self.random.choice(names)
+            shape = self.random.randrange(4)
+            if shape == 0:
+                terms.append(name)
+            elif shape == 1:
+                terms.append(f"{name} * {self.random.randint(2, 9)}")
+            elif shape == 2:
+                terms.append(f"{name} % {self.random.randint(2, 97)}")
+            else:
+                terms.append(str(self.random.randint(0, 999)))
+        return f"({' + '.join(terms)}) % {MODULUS}"
+
+    def condition(self, names: List[str]) -> str:
+        name = self.random.choice(names)
+        # Division gives a double on every implementation, so it is only
+        # compared, never printed.
+        if self.random.randrange(2) == 0:
+            return f"{name} / {self.random.randint(2, 9)} > {name} % 13"
+        return f"{name} % {self.random.randint(2, 5)} == 0"
+
+    # Builds a string of `--width` parts and counts in `hits` how often it
+    # equals the value it has when all its numbers are 0.
+    def string_statement(self, names: List[str]) -> None:
+        self.labels += 1
+        label = f"s{self.labels}"
+        parts = [f'"{label}-"']
+        match = f"{label}-"
+        for _ in range(self.options.width - 1):
+            if self.random.randrange(2) == 0:
+                parts.append(f"{self.random.choice(names)} % 10")
+                match += "0"
+            else:
+                letter = self.random.choice("abcdef")
+                parts.append(f'"{letter}"')
+                match += letter
+        self.emit(f"local {label} := {' + '.join(parts)}")
+        self.emit(f'if {label} == "{match}" then')
+        self.emit("  hits := hits + 1")
+        self.emit("end")
+
+    def statement(self, names: List[str], target: str) -> None:
+        if self.random.random() < self.options.strings:
+            self.string_statement(names)
+        else:
+            self.emit(f"{target} := {self.expression(names)}")
+
+    # One block per level: an if with an else, a counted while or a for.
+    def block(self, names: List[str], target: str, level: int) -> None:
+        self.statement(names, target)
+        if level == self.options.depth:
+            return
+        kind = level % 3
+        trips = self.options.inner_trips
+        if kind == 0:
+            self.emit(f"if {self.condition(names)} then")
+            self.indent += 1
+            self.block(names, target, level + 1)
+            self.indent -= 1
+            self.emit("else")
+            self.indent += 1
+            self.block(names, target, level + 1)
+            self.indent -= 1
+            self.emit("end")
+        elif kind == 1:
+            counter = f"w{level}"
+            self.emit(f"local {counter} := 0")
+            self.emit(f"while {counter} < {trips} then")
+            self.indent += 1
+            self.emit(f"{counter} := {counter} + 1")
+            self.block(names + [counter], target, level + 1)
+            self.indent -= 1
+            self.emit("end")
+        else:
+            counter = f"k{level}"
+            self.emit(f"for {counter} := 1, {trips} do")
+            self.indent += 1
+            self.block(names + [counter], target, level + 1)
+            self.indent -= 1
+            self.emit("end")
+
+    def function(self, index: int) -> None:
+        self.emit(f"func f{index}(a, b)")
+        self.indent += 1
+        self.emit(f"local x := {self.expression(['a', 'b'])}")
+        self.block(["a", "b", "x"], "x", 0)
+        if index % CHAIN != 0:
+            self.emit(f"x := (x + f{index - 1}(b, x)) % {MODULUS}")
+        self.emit("ret x")
+        self.indent -= 1
+        self.emit("end")
+
+    def program(self) -> str:
+        options = self.options
+        self.emit(
+            f"-- bench/generate.py --functions {options.functions} "
+            f"--depth {options.depth} --trips {options.trips} "
+            f"--inner-trips {options.inner_trips} --width {options.width} "
+            f"--strings {options.strings} --recursion {options.recursion} "
+            f"--seed {options.seed}"
+        )
+        self.emit("hits := 0")
+        self.emit("func recurse(n, total)")
+        self.emit("  if n == 0 then")
+        self.emit("    ret total")
+        self.emit("  end")
+        self.emit(f"  ret recurse(n - 1, (total + n * 7) % {MODULUS})")
+        self.emit("end")
+        for index in range(options.functions):
+            self.function(index)
+        self.emit("total := 0")
+        self.emit(f"for i := 1, {options.trips} do")
+        for index in range(options.functions):
+            if index % CHAIN != CHAIN - 1 and index != options.functions - 1:
+                continue
+            self.emit(f"  total := (total + f{index}(i, total)) % {MODULUS}")
+        self.emit("end")
+        self.emit("println total")
+        self.emit("println hits")
+        self.emit(f"println recurse({options.recursion}, 0)")
+        return "\n".join(self.lines) + "\n"
+
+
+def generate(options: Options) -> str:
+    return Generator(options).program()
+
+
+def add_arguments(parser: argparse.ArgumentParser) -> None:
+    defaults = Options()
+    parser.add_argument("--functions", type=int, default=defaults.functions)
+    parser.add_argument("--depth", type=int, default=defaults.depth)
+    parser.add_argument("--trips", type=int, default=defaults.trips)
+    parser.add_argument(
+        "--inner-trips", type=int, default=defaults.inner_trips
+    )
+    parser.add_argument("--width", type=int, default=defaults.width)
+    parser.add_argument(
+        "--strings",
+        type=float,
+        default=defaults.strings,
+        help="share of string statements, from 0 to 1",
+    )
+    parser.add_argument("--recursion", type=int, default=defaults.recursion)
+    parser.add_argument("--seed", type=int, default=defaults.seed)
+
+
+def options_from(args: argparse.Namespace) -> Options:
+    return Options(
+        functions=args.functions,
+        depth=args.depth,
+        trips=args.trips,
+        inner_trips=args.inner_trips,
+        width=args.width,
+        strings=args.strings,
+        recursion=args.recursion,
+        seed=args.seed,
+    )
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    add_arguments(parser)
+    parser.add_argument("-o", "--output", help="file to write, or stdout")
+    args = parser.parse_args()
+    program = generate(options_from(args))
+    if args.output is None:
+        sys.stdout.write(program)
+    else:
+        with open(args.output, "w") as file:
+            file.write(program)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,27 @@
+"""Runs a script on the Python tree-walking interpreter.
+
+python/main.py compiles scripts for the Odin VM instead, so the benchmark
+suite starts the interpreter from here.
+"""
+
+import os
+import sys
+
+BENCH = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(BENCH, "..", "python"))
+sys.setrecursionlimit(100000)
+
+from interpreter import Interpreter  # noqa: E402
+from lexer import Lexer  # noqa: E402
+from parser import Parser  # noqa: E402
+
+
+def main() -> None:
+    with open(sys.argv[1]) as file:
+        lexer = Lexer(file.read())
+    lexer.tokenize()
+    Interpreter().interpret_ast(Parser(lexer.tokens).parse())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// `rss FILE COMMAND...` runs the command and writes its peak resident set
+// size in kilobytes to FILE. Linux counts the memory of the process that
+// started a program in the program's peak, so run.py can't start it
+// directly: a Python parent adds its own 10+ MB. This small process starts
+// it instead. Exits with the command's status.
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    puts("usage: rss FILE COMMAND...");
+    exit(EXIT_FAILURE);
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv[2], argv + 2);
+    exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+    puts("Failed to run the command");
+    exit(EXIT_FAILURE);
+  }
+  FILE *file = fopen(argv[1], "w");
+  if (file == NULL) {
+    printf("Failed to open %s\n", argv[1]);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(file, "%ld\n", usage.ru_maxrss);
+  fclose(file);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
@@ -0,0 +1,329 @@
+"""Runs every Pinky implementation over a fixed set of workloads.
+
+Each implementation is built once, then every workload runs a few times
+untimed and `--runs` times timed. The report is JSON on stdout: median and
+95th percentile wall time and peak resident memory per implementation and
+workload. With `--baseline` the medians and peaks are compared with a stored
+report, and the exit status is 1 when any of them regressed by more than
+`--threshold`, and for times also beyond the baseline's 95th percentile.
+`--save-baseline` stores the report as the new baseline.
+
+`--script` runs other programs too, such as ones from bench/generate.py.
+Implementations whose toolchain isn't installed are reported as skipped.
+Progress goes to stderr.
+"""
+
+import argparse
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Any, Dict, List, Optional
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+WORKLOADS = {
+    "fibonacci": "scripts/fibonacci.pinky",
+    "mandelbrot": "scripts/mandelbrot.pinky",
+    "dragon": "scripts/dragon.pinky",
+    "strings": "bench/workloads/strings.pinky",
+    "calls": "bench/workloads/calls.pinky",
+    "scopes": "bench/workloads/scopes.pinky",
+}
+
+
+class Implementation:
+    def __init__(
+        self,
+        name: str,
+        tools: List[str],
+        build: Optional[str],
+        run: str,
+    ):
+        self.name = name
+        # Executables the build and the run need on PATH.
+        self.tools = tools
+        self.build = build
+        # Shell commands. Implementations that share a build command are
+        # built once. In `run`, {script} is the workload and {work} a
+        # scratch directory.
+        self.run = run
+
+    def missing_tool(self) -> Optional[str]:
+        for tool in self.tools:
+            if shutil.which(tool) is None:
+                return tool
+        return None
+
+
+CC = os.environ.get("CC", "clang")
+C_BUILD = (
+    f"mkdir -p c/target/release && {CC} -O3 -o c/target/release/main "
+    "c/*.c -lm -lpthread"
+)
+IMPLEMENTATIONS = [
+    Implementation(
+        "c",
+        [CC],
+        C_BUILD,
+        "c/target/release/main {script}",
+    ),
+    Implementation(
+        "c-tree-walk",
+        [CC],
+        C_BUILD,
+        "c/target/release/main --tree-walk {script}",
+    ),
+    Implementation(
+        "c-flat",
+        [CC],
+        C_BUILD,
+        "c/target/release/main --flat {script}",
+    ),
+    Implementation(
+        "rust",
+        ["cargo"],
+        "cargo build --quiet --release --manifest-path rust/Cargo.toml",
+        "rust/target/release/rust {script}",
+    ),
+    Implementation(
+        "zig",
+        ["zig"],
+        "cd zig && zig build --release=fast",
+        "zig/zig-out/bin/zig {script}",
+    ),
+    Implementation(
+        "python",
+        ["python3"],
+        None,
+        "python3 bench/interpret.py {script}",
+    ),
+    # The Python frontend compiles to code.vm, which the Odin VM reads from
+    # its working directory.
+    Implementation(
+        "odin-vm",
+        ["python3", "odin"],
+        "mkdir -p vm/target && odin build vm -o:speed -out:vm/target/vm",
+        "python3 python/main.py {script} > {work}/code.vm && "
+        "cd {work} && " + os.path.join(ROOT, "vm/target/vm"),
+    ),
+]
+
+
+def log(message: str) -> None:
+    print(message, file=sys.stderr, flush=True)
+
+
+# Wall time in seconds and peak resident set size in kilobytes, None when
+# the rss helper couldn't be built.
+def measure(command: str, work: str, rss: Optional[str]) -> Dict[str, Any]:
+    stderr = os.path.join(work, "stderr")
+    peak = os.path.join(work, "rss")
+    argv = ["sh", "-c", command]
+    if rss is not None:
+        argv = [rss, peak] + argv
+    actions = [
+        (os.POSIX_SPAWN_OPEN, 1, os.devnull, os.O_WRONLY, 0),
+        (os.POSIX_SPAWN_OPEN, 2, stderr, os.O_WRONLY | os.O_CREAT, 0o644),
+    ]
+    start = time.perf_counter()
+    pid = os.posix_spawnp(argv[0], argv, os.environ, file_actions=actions)
+    _, status, _ = os.wait4(pid, 0)
+    seconds = time.perf_counter() - start
+    with open(stderr) as file:
+        message = file.read()[-500:]
+    rss_kb = None
+    if rss is not None:
+        with open(peak) as file:
+            rss_kb = int(file.read())
+    return {
+        "seconds": seconds,
+        "rss_kb": rss_kb,
+        "status": os.waitstatus_to_exitcode(status),
+        "stderr": message,
+    }
+
+
+# Nearest rank: the smallest sample at or above the given share of samples.
+def percentile(samples: List[float], share: float) -> float:
+    ordered = sorted(samples)
+    return ordered[max(0, math.ceil(share * len(ordered)) - 1)]
+
+
+def bench(
+    implementation: Implementation,
+    workload: str,
+    runs: int,
+    warmup: int,
+    rss: Optional[str],
+) -> Dict[str, Any]:
+    result: Dict[str, Any] = {
+        "implementation": implementation.name,
+        "workload": workload,
+    }
+    script = os.path.join(ROOT, WORKLOADS[workload])
+    with tempfile.TemporaryDirectory() as work:
+        command = implementation.run.format(script=script, work=work)
+        seconds = []
+        peaks = []
+        for i in range(warmup + runs):
+            sample = measure(command, work, rss)
+            if sample["status"] != 0:
+                result["error"] = (
+                    f"exit status {sample['status']}: {sample['stderr']}"
+                )
+                return result
+            if i >= warmup:
+                seconds.append(sample["seconds"])
+                peaks.append(sample["rss_kb"])
+    result["runs"] = runs
+    result["median_ms"] = round(percentile(seconds, 0.5) * 1000, 3)
+    result["p95_ms"] = round(percentile(seconds, 0.95) * 1000, 3)
+    result["max_rss_kb"] = None if rss is None else max(peaks)
+    return result
+
+
+def key(result: Dict[str, Any]) -> str:
+    return f"{result['implementation']}/{result['workload']}"
+
+
+def regressions(
+    report: Dict[str, Any], baseline: Dict[str, Any], threshold: float
+) -> List[Dict[str, Any]]:
+    before = {key(result): result for result in baseline["results"]}
+    found = []
+    for result in report["results"]:
+        old = before.get(key(result))
+        if old is None or "median_ms" not in old or "median_ms" not in result:
+            continue
+        for metric in ("median_ms", "max_rss_kb"):
+            if result[metric] is None or old[metric] is None:
+                continue
+            limit = old[metric] * (1 + threshold)
+            # A median within the old spread is noise, however large.
+            if metric == "median_ms":
+                limit = max(limit, old["p95_ms"])
+            if result[metric] > limit:
+                found.append(
+                    {
+                        "benchmark": key(result),
+                        "metric": metric,
+                        "baseline": old[metric],
+                        "current": result[metric],
+                        "change": round(result[metric] / old[metric] - 1, 3),
+                    }
+                )
+    return found
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--runs", type=int, default=10)
+    parser.add_argument("--warmup", type=int, default=2)
+    parser.add_argument(
+        "--implementation",
+        action="append",
+        choices=[implementation.name for implementation in IMPLEMENTATIONS],
+        help="run only these implementations (repeatable)",
+    )
+    parser.add_argument(
+        "--workload",
+        action="append",
+        choices=list(WORKLOADS),
+        help="run only these workloads (repeatable)",
+    )
+    parser.add_argument(
+        "--script",
+        action="append",
+        default=[],
+        help="also run this script, named after its file (repeatable)",
+    )
+    parser.add_argument("--no-build", action="store_true")
+    parser.add_argument("--baseline", help="report to compare with")
+    parser.add_argument("--save-baseline", help="file to store the report in")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.1,
+        help="allowed growth over the baseline, 0.1 is 10%%",
+    )
+    args = parser.parse_args()
+    scripts = []
+    for path in args.script:
+        name = os.path.splitext(os.path.basename(path))[0]
+        WORKLOADS[name] = os.path.abspath(path)
+        scripts.append(name)
+    # Commands use paths relative to the repository.
+    os.chdir(ROOT)
+
+    implementations = [
+        implementation
+        for implementation in IMPLEMENTATIONS
+        if args.implementation is None
+        or implementation.name in args.implementation
+    ]
+    # Scripts alone replace the default workloads, e.g. for programs from
+    # bench/generate.py.
+    workloads = args.workload or ([] if scripts else list(WORKLOADS))
+    workloads += scripts
+    rss: Optional[str] = "bench/target/rss"
+    helper = f"mkdir -p bench/target && {CC} -O2 -o {rss} bench/rss.c"
+    if shutil.which(CC) is None or subprocess.run(helper, shell=True).returncode:
+        log("can't build bench/rss.c, peak memory won't be measured")
+        rss = None
+    report: Dict[str, Any] = {
+        "runs": args.runs,
+        "warmup": args.warmup,
+        "results": [],
+    }
+    builds: Dict[str, bool] = {}
+    for implementation in implementations:
+        missing = implementation.missing_tool()
+        build = implementation.build
+        if missing is None and build and not args.no_build:
+            if build not in builds:
+                log(f"building {implementation.name}")
+                process = subprocess.run(build, shell=True)
+                builds[build] = process.returncode == 0
+            if not builds[build]:
+                missing = "a successful build"
+        for workload in workloads:
+            if missing is not None:
+                report["results"].append(
+                    {
+                        "implementation": implementation.name,
+                        "workload": workload,
+                        "skipped": f"needs {missing}",
+                    }
+                )
+                continue
+            log(f"running {implementation.name} {workload}")
+            report["results"].append(
+                bench(implementation, workload, args.runs, args.warmup, rss)
+            )
+
+    regressed: List[Dict[str, Any]] = []
+    if args.baseline:
+        with open(args.baseline) as file:
+            regressed = regressions(report, json.load(file), args.threshold)
+        report["regressions"] = regressed
+        for regression in regressed:
+            log(
+                f"REGRESSION {regression['benchmark']} {regression['metric']}: "
+                f"{regression['baseline']} -> {regression['current']}"
+            )
+    if args.save_baseline:
+        with open(args.save_baseline, "w") as file:
+            json.dump(report, file, indent=2)
+            file.write("\n")
+    json.dump(report, sys.stdout, indent=2)
+    print()
+    if regressed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
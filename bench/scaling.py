@@ -0,0 +1,138 @@
+"""Measures how the C lexer, parser and tree walker scale with program size.
+
+Each sweep grows one option of bench/generate.py while the others keep
+their values, and times the generated programs with c/bench/phases.c. The
+report is JSON on stdout: per sweep, the cost per token, per AST node and per
+evaluated node at every size. A phase whose cost per item at the largest
+size is more than `--threshold` above its cost at the smallest size is
+reported as superlinear, and the exit status is 1. Progress goes to stderr.
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from typing import Any, Dict, List
+
+from generate import Options, add_arguments, generate, options_from
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SWEEPS = {
+    "functions": [50, 100, 200, 400, 800, 1600],
+    "depth": [2, 4, 6, 8, 10],
+    "trips": [100, 200, 400, 800, 1600],
+    "width": [2, 4, 8, 16, 32, 64],
+    "recursion": [100, 200, 400, 800, 1600, 3200],
+}
+PHASES = "bench/target/phases"
+# One line of c/bench/phases.c output.
+LINE = re.compile(
+    r"lexer +([\d.]+) ns/token \((\d+)\), "
+    r"parser +([\d.]+) ns/node \((\d+)\), "
+    r"tree walker +([\d.]+) ns/node \((\d+)\)"
+)
+
+
+def log(message: str) -> None:
+    print(message, file=sys.stderr, flush=True)
+
+
+def build() -> None:
+    sources = [
+        source for source in glob.glob("c/*.c") if source != "c/main.c"
+    ]
+    command = [os.environ.get("CC", "clang"), "-O3", "-DSTATS_COUNTERS"]
+    command += ["-o", PHASES]
+    command += ["c/bench/phases.c"] + sorted(sources) + ["-lm", "-lpthread"]
+    os.makedirs(os.path.dirname(PHASES), exist_ok=True)
+    subprocess.run(command, check=True)
+
+
+def measure(options: Options, runs: int, work: str) -> Dict[str, Any]:
+    script = os.path.join(work, "generated.pinky")
+    with open(script, "w") as file:
+        file.write(generate(options))
+    output = subprocess.run(
+        [PHASES, "--runs", str(runs), script],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+    match = LINE.search(output)
+    if match is None:
+        raise RuntimeError(f"unexpected output of {PHASES}: {output}")
+    return {
+        "bytes": os.path.getsize(script),
+        "tokens": int(match[2]),
+        "lexer_ns": float(match[1]),
+        "nodes": int(match[4]),
+        "parser_ns": float(match[3]),
+        "evaluated": int(match[6]),
+        "tree_walker_ns": float(match[5]),
+    }
+
+
+# Phases whose cost per item grew by more than `threshold` over the sweep.
+def superlinear(points: List[Dict[str, Any]], threshold: float) -> List[str]:
+    found = []
+    for phase in ("lexer_ns", "parser_ns", "tree_walker_ns"):
+        first = points[0][phase]
+        last = points[-1][phase]
+        if first > 0 and last > first * (1 + threshold):
+            found.append(phase)
+    return found
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    add_arguments(parser)
+    parser.add_argument(
+        "--sweep",
+        action="append",
+        choices=list(SWEEPS),
+        help="grow only these options (repeatable)",
+    )
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.5,
+        help="allowed growth of the cost per item, 0.5 is 50%%",
+    )
+    parser.add_argument("--no-build", action="store_true")
+    args = parser.parse_args()
+    os.chdir(ROOT)
+    if not args.no_build:
+        build()
+
+    report: Dict[str, Any] = {"runs": args.runs, "sweeps": []}
+    failed = False
+    with tempfile.TemporaryDirectory() as work:
+        for name in args.sweep or list(SWEEPS):
+            points = []
+            for value in SWEEPS[name]:
+                log(f"{name} = {value}")
+                options = options_from(args)
+                setattr(options, name, value)
+                point = measure(options, args.runs, work)
+                point[name] = value
+                points.append(point)
+            phases = superlinear(points, args.threshold)
+            for phase in phases:
+                log(f"SUPERLINEAR {name}: {phase}")
+            failed = failed or bool(phases)
+            report["sweeps"].append(
+                {"option": name, "points": points, "superlinear": phases}
+            )
+    json.dump(report, sys.stdout, indent=2)
+    print()
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
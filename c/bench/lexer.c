@@ -0,0 +1,107 @@
+#include "../lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Tokenizes a generated multi-megabyte script several times and reports the
+// lexer throughput. Build it with `make bench-c-lexer`, or with
+// `make bench-c-parallel-lexer` to measure parallel lexing on every core.
+
+#define SOURCE_SIZE (16 * 1024 * 1024)
+#define RUNS 9
+
+#if defined(SCAN_SCALAR)
+#define SCAN_VARIANT "scalar"
+#elif defined(__AVX2__)
+#define SCAN_VARIANT "avx2"
+#elif defined(__SSE2__)
+#define SCAN_VARIANT "sse2"
+#else
+#define SCAN_VARIANT "scalar"
+#endif
+
+// Appends lines of indented code, comments, strings and numbers until the
+// buffer is full.
+long generate(char *source, long size) {
+  char *names[] = {"counter", "total", "x", "index_value", "result", "f"};
+  long len = 0;
+  unsigned int seed = 1;
+  char line[256];
+  while (1) {
+    seed = seed * 1103515245 + 12345;
+    char *name = names[(seed >> 16) % 6];
+    int written;
+    switch ((seed >> 8) % 5) {
+    case 0:
+      written = snprintf(line, sizeof(line), "%s := %s + %u * 3.25\n", name,
+                         name, seed % 100000);
+      break;
+    case 1:
+      written = snprintf(line, sizeof(line),
+                         "    println \"%s is now \" + %s\n", name, name);
+      break;
+    case 2:
+      written = snprintf(line, sizeof(line),
+                         "-- update %s before the next iteration starts\n",
+                         name);
+      break;
+    case 3:
+      written = snprintf(line, sizeof(line),
+                         "while %s < %u then\n        %s := %s + 1\nend\n",
+                         name, seed % 1000, name, name);
+      break;
+    default:
+      written = snprintf(line, sizeof(line), "\n    \t\n");
+      break;
+    }
+    if (len + written > size)
+      return len;
+    memcpy(source + len, line, written);
+    len += written;
+  }
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double left = *(const double *)a;
+  double right = *(const double *)b;
+  return (left > right) - (left < right);
+}
+
+// Median seconds of tokenizing the source with the given number of threads.
+double measure(char *source, long len, int threads, long *tokens) {
+  double seconds[RUNS];
+  for (int i = 0; i < RUNS; i++) {
+    Lexer lexer = (Lexer){0, 0, 0, source, len};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tokenize_parallel(&lexer, threads);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds[i] =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    *tokens = lexer.tokens_len;
+    free(lexer.tokens);
+  }
+  qsort(seconds, RUNS, sizeof(double), compare_doubles);
+  return seconds[RUNS / 2];
+}
+
+// `lexer N` measures every thread count from 1 to N.
+int main(int argc, char *argv[]) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : 1;
+  char *source = malloc(SOURCE_SIZE);
+  long len = generate(source, SOURCE_SIZE);
+  double megabytes = len / (1024.0 * 1024.0);
+  double serial = 0;
+  for (int threads = 1; threads <= max_threads; threads++) {
+    long tokens;
+    double seconds = measure(source, len, threads, &tokens);
+    if (threads == 1)
+      serial = seconds;
+    printf("lexer (%s, %d threads): %.1f MB, %ld tokens, median %.1f MB/s, "
+           "speedup %.2fx\n",
+           SCAN_VARIANT, threads, megabytes, tokens, megabytes / seconds,
+           serial / seconds);
+  }
+  free(source);
+}
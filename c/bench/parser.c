@@ -0,0 +1,96 @@
+#include "../lexer.h"
+#include "../memory.h"
+#include "../parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Parses a generated multi-megabyte script of long expressions several
+// times and reports the parser throughput. The script is tokenized once, so
+// only parsing is timed. Build it with `make bench-c-parser`.
+
+#define SOURCE_SIZE (8 * 1024 * 1024)
+#define RUNS 9
+
+// Appends assignments and prints whose expressions use every operator
+// level, calls, groupings and unary operators until the buffer is full.
+long generate(char *source, long size) {
+  char *names[] = {"counter", "total", "x", "index_value", "result", "f"};
+  long len = 0;
+  unsigned int seed = 1;
+  char line[512];
+  while (1) {
+    seed = seed * 1103515245 + 12345;
+    char *a = names[(seed >> 16) % 6];
+    char *b = names[(seed >> 20) % 6];
+    unsigned int n = seed % 1000;
+    int written;
+    switch ((seed >> 8) % 4) {
+    case 0:
+      written = snprintf(line, sizeof(line),
+                         "%s := (%s + %u) * %s - %s / 2 %% 7 + %u.5 ^ 2\n", a,
+                         b, n, a, b, n);
+      break;
+    case 1:
+      written = snprintf(line, sizeof(line),
+                         "println %s + %u >= %s * 3 and ~(%s == %u) or "
+                         "%s < -%s\n",
+                         a, n, b, a, n, b, a);
+      break;
+    case 2:
+      written = snprintf(line, sizeof(line),
+                         "%s := g(%s, %s * (%u - %s), \"text\") + -%s\n", a,
+                         b, a, n, b, a);
+      break;
+    default:
+      written = snprintf(line, sizeof(line),
+                         "print ((%s - %u) * (%s + %s)) / (%u + %s ^ 2) ~= "
+                         "%s\n",
+                         a, n, b, a, n, b, a);
+      break;
+    }
+    if (len + written > size)
+      return len;
+    memcpy(source + len, line, written);
+    len += written;
+  }
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double left = *(const double *)a;
+  double right = *(const double *)b;
+  return (left > right) - (left < right);
+}
+
+int main(void) {
+  char *source = malloc(SOURCE_SIZE);
+  long len = generate(source, SOURCE_SIZE);
+  Lexer lexer = (Lexer){0, 0, 0, source, len};
+  tokenize_parallel(&lexer, 1);
+
+  Arena arena = new_arena();
+  double seconds[RUNS];
+  size_t ast_bytes = 0;
+  for (int i = 0; i < RUNS; i++) {
+    arena.pointer = 0;
+    Parser parser =
+        (Parser){0, lexer.tokens_len, &arena, lexer.tokens, source};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parse(&parser);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds[i] =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    ast_bytes = arena.pointer;
+  }
+  qsort(seconds, RUNS, sizeof(double), compare_doubles);
+  double median = seconds[RUNS / 2];
+  double megabytes = len / (1024.0 * 1024.0);
+  printf("parser: %.1f MB, %ld tokens, %.1f MB of AST, median %.1f MB/s, "
+         "%.1f M tokens/s\n",
+         megabytes, lexer.tokens_len, ast_bytes / (1024.0 * 1024.0),
+         megabytes / median, lexer.tokens_len / median / 1e6);
+  free(lexer.tokens);
+  free(source);
+}
@@ -0,0 +1,198 @@
+#include "../interpreter.h"
+#include "../lexer.h"
+#include "../memory.h"
+#include "../model.h"
+#include "../optimizer.h"
+#include "../output.h"
+#include "../parser.h"
+#include "../resolver.h"
+#include "../source.h"
+#include "../stats.h"
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Times tokenizing, parsing and tree walking of each given script on their
+// own, so a slowdown can be pinned on the frontend or the runtime. Every
+// phase runs once untimed and then `--runs` times; the report is the median
+// per token, per parsed AST node and per evaluated node. The arena is reset
+// before every run, so runs don't see each other's allocations. Build and
+// run it on the benchmark workloads with `make bench-c-phases`. Evaluated
+// nodes are counted with STATS_COUNTERS, so the tree walker's times include
+// the cost of all its counters.
+
+#ifndef STATS_COUNTERS
+#error "c/bench/phases.c needs -DSTATS_COUNTERS"
+#endif
+
+#define RUNS 9
+
+typedef struct Phase Phase;
+
+// Median seconds of one phase and how many items it processed.
+struct Phase {
+  double seconds;
+  size_t items;
+};
+
+int compare_doubles(const void *a, const void *b) {
+  double left = *(const double *)a;
+  double right = *(const double *)b;
+  return (left > right) - (left < right);
+}
+
+double elapsed(struct timespec *start, struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) +
+         (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+double median(double *seconds, int runs) {
+  qsort(seconds, runs, sizeof(double), compare_doubles);
+  return seconds[runs / 2];
+}
+
+size_t statements_nodes(Statements *stmts);
+
+size_t statement_nodes(Statement *statement) {
+  switch (statement->type) {
+  case PRINT:
+    return 1 + expression_nodes(statement->PrintStatement.value);
+  case PRINTLN:
+    return 1 + expression_nodes(statement->PrintlnStatement.value);
+  case IF:
+    return 1 + expression_nodes(statement->IfStatement.test) +
+           statements_nodes(statement->IfStatement.then_stmts) +
+           statements_nodes(statement->IfStatement.else_stmts);
+  case ASSIGNMENT:
+    return 1 + expression_nodes(statement->Assignment.left) +
+           expression_nodes(statement->Assignment.right);
+  case LOCAL_ASSIGNMENT:
+    return 1 + expression_nodes(&statement->LocalAssignment.left) +
+           expression_nodes(&statement->LocalAssignment.right);
+  case WHILE:
+    return 1 + expression_nodes(statement->While.test) +
+           statements_nodes(statement->While.stmts);
+  case FOR:
+    return 1 + expression_nodes(statement->For.identifier) +
+           expression_nodes(statement->For.start) +
+           expression_nodes(statement->For.stop) +
+           expression_nodes(statement->For.step) +
+           statements_nodes(statement->For.stmts);
+  case STATEMENT_FUNCTION_CALL:
+    return 1 + expression_nodes(statement->FunctionCall.expr);
+  case FUNCTION_DECLARATION:
+    return 1 + statements_nodes(statement->FunctionDeclaration.params) +
+           statements_nodes(statement->FunctionDeclaration.stmts);
+  case RET:
+    return 1 + expression_nodes(&statement->Return.val);
+  case PARAMETER:
+    return 1;
+  }
+  return 0;
+}
+
+size_t statements_nodes(Statements *stmts) {
+  size_t nodes = 0;
+  for (Statement *stmt = stmts->head; stmt != NULL; stmt = stmt->next)
+    nodes += statement_nodes(stmt);
+  return nodes;
+}
+
+Phase time_lexer(Source *source, int runs) {
+  double seconds[runs];
+  size_t tokens = 0;
+  for (int i = -1; i < runs; i++) {
+    Lexer lexer = (Lexer){0, 0, 0, source->text, source->len};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tokenize_parallel(&lexer, 1);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (i >= 0)
+      seconds[i] = elapsed(&start, &end);
+    tokens = lexer.tokens_len;
+    free(lexer.tokens);
+  }
+  return (Phase){median(seconds, runs), tokens};
+}
+
+// Leaves the last tree in `arena` and returns it in `tree`.
+Phase time_parser(Source *source, Arena *arena, int runs, Node *tree) {
+  Lexer lexer = (Lexer){0, 0, 0, source->text, source->len};
+  tokenize_parallel(&lexer, 1);
+  double seconds[runs];
+  for (int i = -1; i < runs; i++) {
+    arena_reset(arena, 0);
+    Parser parser =
+        (Parser){0, lexer.tokens_len, arena, lexer.tokens, source->text};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    *tree = parse(&parser);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (i >= 0)
+      seconds[i] = elapsed(&start, &end);
+  }
+  free(lexer.tokens);
+  return (Phase){median(seconds, runs), statements_nodes(tree->stmts)};
+}
+
+// Program output goes to /dev/null while the tree is walked. The untimed
+// run also leaves the tree quickened, as it is in a long running program.
+Phase time_interpreter(Node tree, Arena *arena, int runs) {
+  optimize(tree, arena);
+  resolve(tree);
+  size_t mark = arena->pointer;
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  double seconds[runs];
+  size_t evaluated = 0;
+  for (int i = -1; i < runs; i++) {
+    arena_reset(arena, mark);
+    stats.evaluated_nodes = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    interpret_ast(tree, arena);
+    output_flush();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (i >= 0)
+      seconds[i] = elapsed(&start, &end);
+    evaluated = stats.evaluated_nodes;
+  }
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  close(null);
+  return (Phase){median(seconds, runs), evaluated};
+}
+
+// `phases [--runs N] SCRIPT...`
+int main(int argc, char *argv[]) {
+  int runs = RUNS;
+  Arena arena = new_arena();
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+      if (runs < 1) {
+        puts("--runs needs a positive count");
+        exit(EXIT_FAILURE);
+      }
+      continue;
+    }
+    Source source = source_open(argv[i]);
+    Node tree;
+    Phase lexer = time_lexer(&source, runs);
+    Phase parser = time_parser(&source, &arena, runs, &tree);
+    Phase interpreter = time_interpreter(tree, &arena, runs);
+    printf("%-20s lexer %6.1f ns/token (%zu), parser %6.1f ns/node (%zu), "
+           "tree walker %6.1f ns/node (%zu)\n",
+           basename(argv[i]), lexer.seconds * 1e9 / lexer.items,
+           lexer.items, parser.seconds * 1e9 / parser.items, parser.items,
+           interpreter.seconds * 1e9 / interpreter.items,
+           interpreter.items);
+    source_close(&source);
+  }
+}
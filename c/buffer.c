@@ -0,0 +1,97 @@
+#include "buffer.h"
+#include "memory.h"
+#include "stats.h"
+#include "symbols.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+Retired retired;
+
+StringBuffer *string_buffer(InterpretResult *value) {
+  return (StringBuffer *)(value->String.value - offsetof(StringBuffer, chars));
+}
+
+// Appends in place when `left` ends where the claimed bytes of its buffer
+// end. `right` may point into the same buffer, below the appended bytes.
+bool buffer_append(InterpretResult *left, char *right, unsigned int len) {
+  if (!left->owned)
+    return false;
+  StringBuffer *buffer = string_buffer(left);
+  if (buffer->len != left->len || left->len + len >= buffer->cap)
+    return false;
+  memcpy(buffer->chars + left->len, right, len);
+  buffer->len += len;
+  buffer->chars[buffer->len] = '\0';
+  left->len += len;
+  return true;
+}
+
+// Stores `value` into `var`, a variable of `state`. Strings built at run
+// time are copied into the variable's buffer, unless they already are the
+// start of it.
+void buffer_store(State *state, InterpretResult *var, InterpretResult value) {
+  StringBuffer *old = var->owned ? string_buffer(var) : NULL;
+  if (old != NULL && value.owned && value.String.value == old->chars) {
+    *var = value;
+    return;
+  }
+  if (value.type == STR && value.symbol == NO_SYMBOL) {
+    StringBuffer *buffer;
+    if (old != NULL && value.len < old->cap && state->depth == call_depth) {
+      buffer = old;
+      old = NULL;
+    } else {
+      unsigned int cap = value.len + 1;
+      // Grown strings are likely to grow again.
+      if (old != NULL && cap > old->cap && cap < old->cap * 2)
+        cap = old->cap * 2;
+      buffer = malloc(sizeof(StringBuffer) + cap);
+      buffer->cap = cap;
+    }
+    memcpy(buffer->chars, value.String.value, value.len);
+    buffer->chars[value.len] = '\0';
+    buffer->len = value.len;
+    value.String.value = buffer->chars;
+    value.owned = true;
+    COUNT_ADD(escaped_bytes, value.len + 1);
+  }
+  if (old != NULL)
+    buffer_release(old, state);
+  *var = value;
+}
+
+// Frees the buffer of a variable of `state` that no longer holds it.
+void buffer_release(StringBuffer *buffer, State *state) {
+  if (state->depth == call_depth) {
+    free(buffer);
+    return;
+  }
+  GROW(retired.buffers, retired.len, retired.cap);
+  retired.buffers[retired.len++] = (RetiredBuffer){buffer, state->depth};
+}
+
+// Copies a string out of a variable's buffer to scratch.
+InterpretResult buffer_detach(InterpretResult value, Arena *scratch) {
+  if (!value.owned)
+    return value;
+  char *copy = arena_alloc(scratch, value.len + 1);
+  memcpy(copy, value.String.value, value.len);
+  copy[value.len] = '\0';
+  value.String.value = copy;
+  value.owned = false;
+  return value;
+}
+
+// Runs between statements: frees the buffers retired by functions that the
+// running function called.
+void buffers_collect(void) {
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < retired.len; i++) {
+    if (retired.buffers[i].depth >= call_depth)
+      free(retired.buffers[i].buffer);
+    else
+      retired.buffers[kept++] = retired.buffers[i];
+  }
+  retired.len = kept;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "memory.h"
+#include "model.h"
+#include "state.h"
+#include <stdbool.h>
+
+// Strings stored into a variable are copied into a StringBuffer the variable
+// owns. Values read from the variable point into the buffer and have `owned`
+// set. Bytes a string points to are never changed, so appending to the value
+// of a variable writes past its end, as long as no other string claimed
+// those bytes already and they fit. `s := s + t` then grows `s` in place, and
+// storing the result back into `s` needs no copy.
+//
+// A variable frees its buffer when a different value is stored into it.
+// Values read from a variable of a function further up the call stack can
+// still be in use by the expression that called the running function, so
+// their buffers are retired instead, and freed at the next statement that
+// function runs. A returned string is copied out of its variable, whose
+// buffer is freed with the variable's scope.
+
+typedef struct StringBuffer StringBuffer;
+typedef struct RetiredBuffer RetiredBuffer;
+typedef struct Retired Retired;
+
+struct StringBuffer {
+  // Bytes claimed by strings, the terminator not counted.
+  unsigned int len;
+  unsigned int cap;
+  char chars[];
+};
+
+// `depth` is the call depth of the function the variable belonged to.
+struct RetiredBuffer {
+  StringBuffer *buffer;
+  unsigned int depth;
+};
+
+struct Retired {
+  RetiredBuffer *buffers;
+  unsigned int len;
+  unsigned int cap;
+};
+
+extern Retired retired;
+
+StringBuffer *string_buffer(InterpretResult *value);
+bool buffer_append(InterpretResult *left, char *right, unsigned int len);
+void buffer_store(State *state, InterpretResult *var, InterpretResult value);
+void buffer_release(StringBuffer *buffer, State *state);
+InterpretResult buffer_detach(InterpretResult value, Arena *scratch);
+void buffers_collect(void);
@@ -0,0 +1,433 @@
+#include "compiler.h"
+#include "interpreter.h"
+#include "model.h"
+#include "symbols.h"
+#include "tokens.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned int emit(Chunk *chunk, enum OPCODE opcode, unsigned int operand) {
+  GROW(chunk->code, chunk->code_len, chunk->code_cap);
+  chunk->code[chunk->code_len] = INSTRUCTION(opcode, operand);
+  return chunk->code_len++;
+}
+
+void patch_jump(Chunk *chunk, unsigned int jump) {
+  chunk->code[jump] = INSTRUCTION(OPCODE(chunk->code[jump]), chunk->code_len);
+}
+
+unsigned int add_constant(Chunk *chunk, InterpretResult constant) {
+  GROW(chunk->constants, chunk->constants_len, chunk->constants_cap);
+  chunk->constants[chunk->constants_len] = constant;
+  return chunk->constants_len++;
+}
+
+unsigned int emit_constant(Chunk *chunk, InterpretResult constant) {
+  return emit(chunk, OP_PUSH, add_constant(chunk, constant));
+}
+
+unsigned int emit_load(Chunk *chunk, Expression *identifier) {
+  assert(identifier->type == IDENTIFIER);
+  if (identifier->Identifier.depth == UNRESOLVED)
+    return emit_constant(chunk, (InterpretResult){.type = NONE});
+  assert(identifier->Identifier.depth < 256 &&
+         identifier->Identifier.slot < 65536);
+  if (identifier->Identifier.depth == 0)
+    return emit(chunk, OP_LOAD_LOCAL, identifier->Identifier.slot);
+  return emit(chunk, OP_LOAD_VAR,
+              VARIABLE(identifier->Identifier.depth,
+                       identifier->Identifier.slot));
+}
+
+unsigned int emit_store(Chunk *chunk, Expression *identifier) {
+  assert(identifier->type == IDENTIFIER);
+  assert(identifier->Identifier.depth != UNRESOLVED);
+  assert(identifier->Identifier.depth < 256 &&
+         identifier->Identifier.slot < 65536);
+  if (identifier->Identifier.depth == 0)
+    return emit(chunk, OP_STORE_LOCAL, identifier->Identifier.slot);
+  return emit(chunk, OP_STORE_VAR,
+              VARIABLE(identifier->Identifier.depth,
+                       identifier->Identifier.slot));
+}
+
+// Blocks that declare nothing don't get a scope, see the resolver.
+void emit_enter_scope(Chunk *chunk, Statements *stmts) {
+  if (!stmts->has_scope)
+    return;
+  assert(stmts->scope_size < 65536 && stmts->funcs_size < 256);
+  emit(chunk, OP_ENTER_SCOPE, SCOPE(stmts->scope_size, stmts->funcs_size));
+}
+
+void emit_exit_scope(Chunk *chunk, Statements *stmts) {
+  if (stmts->has_scope)
+    emit(chunk, OP_EXIT_SCOPE, 0);
+}
+
+unsigned int add_call(Chunk *chunk, Expression *call) {
+  GROW(chunk->calls, chunk->calls_len, chunk->calls_cap);
+  chunk->calls[chunk->calls_len] =
+      (CallSite){call->FunctionCall.symbol, call->FunctionCall.args->length};
+  return chunk->calls_len++;
+}
+
+unsigned int add_function(Chunk *chunk, Statement *function) {
+  GROW(chunk->functions, chunk->functions_len, chunk->functions_cap);
+  chunk->functions[chunk->functions_len] = function;
+  return chunk->functions_len++;
+}
+
+enum OPCODE operator_opcode(TokenType token_type) {
+  switch (token_type) {
+  case TokPlus:
+    return OP_ADD;
+  case TokMinus:
+    return OP_SUB;
+  case TokStar:
+    return OP_MUL;
+  case TokSlash:
+    return OP_DIV;
+  case TokMod:
+    return OP_MOD;
+  case TokCaret:
+    return OP_EXP;
+  case TokEq:
+    return OP_EQ;
+  case TokNe:
+    return OP_NE;
+  case TokLt:
+    return OP_LT;
+  case TokGt:
+    return OP_GT;
+  case TokLe:
+    return OP_LE;
+  case TokGe:
+    return OP_GE;
+  default:
+    assert(false);
+    return OP_HALT;
+  }
+}
+
+void compile_expression(Chunk *chunk, Expression *expression) {
+  unsigned int jump;
+  switch (expression->type) {
+  case INTEGER:
+    emit_constant(chunk, (InterpretResult){.type = INT,
+                                           .Int.value =
+                                               expression->Integer.value});
+    break;
+  case FLOAT:
+    emit_constant(chunk, (InterpretResult){.type = NUMBER,
+                                           .Number.value =
+                                               expression->Float.value});
+    break;
+  case BOOL:
+    emit_constant(chunk, (InterpretResult){.type = BOOLEAN,
+                                           .Bool.value =
+                                               expression->Bool.value});
+    break;
+  case STRING:
+    emit_constant(chunk,
+                  (InterpretResult){.type = STR,
+                                    .symbol = expression->String.symbol,
+                                    .len = expression->String.len,
+                                    .String.value = expression->String.value});
+    break;
+  case IDENTIFIER:
+    emit_load(chunk, expression);
+    break;
+  case GROUPING:
+    compile_expression(chunk, expression->Grouping.exp);
+    break;
+  case UNARY_OP:
+    compile_expression(chunk, expression->UnaryOp.exp);
+    if (expression->UnaryOp.op.token_type == TokMinus)
+      emit(chunk, OP_NEG, 0);
+    else if (expression->UnaryOp.op.token_type == TokNot)
+      emit(chunk, OP_NOT, 0);
+    break;
+  case LOGICAL_OP:
+    if (expression->LogicalOp.op.token_type == TokAnd ||
+        expression->LogicalOp.op.token_type == TokOr) {
+      compile_expression(chunk, expression->LogicalOp.left);
+      jump = emit(chunk,
+                  expression->LogicalOp.op.token_type == TokAnd ? OP_AND
+                                                                : OP_OR,
+                  0);
+      compile_expression(chunk, expression->LogicalOp.right);
+      patch_jump(chunk, jump);
+      break;
+    }
+    compile_expression(chunk, expression->LogicalOp.left);
+    compile_expression(chunk, expression->LogicalOp.right);
+    emit(chunk, operator_opcode(expression->LogicalOp.op.token_type), 0);
+    break;
+  case BINARY_OP:
+  case BINARY_INT:
+  case BINARY_NUMBER:
+  case BINARY_STRING:
+    compile_expression(chunk, expression->BinaryOp.left);
+    compile_expression(chunk, expression->BinaryOp.right);
+    emit(chunk, operator_opcode(expression->BinaryOp.op.token_type), 0);
+    break;
+  case FUNCTION_CALL:;
+    Expression *arg = expression->FunctionCall.args->head;
+    for (int i = 0; i < expression->FunctionCall.args->length; i++) {
+      compile_expression(chunk, arg);
+      arg = arg->next;
+    }
+    emit(chunk, OP_CALL, add_call(chunk, expression));
+    break;
+  }
+}
+
+void compile_statement(Chunk *chunk, Statement *statement) {
+  unsigned int jump;
+  unsigned int loop;
+  switch (statement->type) {
+  case PRINT:
+    compile_expression(chunk, statement->PrintStatement.value);
+    emit(chunk, OP_PRINT, 0);
+    break;
+  case PRINTLN:
+    compile_expression(chunk, statement->PrintlnStatement.value);
+    emit(chunk, OP_PRINTLN, 0);
+    break;
+  case IF:
+    compile_expression(chunk, statement->IfStatement.test);
+    jump = emit(chunk, OP_JMPZ, 0);
+    emit_enter_scope(chunk, statement->IfStatement.then_stmts);
+    compile_statements(chunk, statement->IfStatement.then_stmts);
+    emit_exit_scope(chunk, statement->IfStatement.then_stmts);
+    if (statement->IfStatement.else_stmts->head == NULL) {
+      patch_jump(chunk, jump);
+      break;
+    }
+    unsigned int else_jump = emit(chunk, OP_JMP, 0);
+    patch_jump(chunk, jump);
+    emit_enter_scope(chunk, statement->IfStatement.else_stmts);
+    compile_statements(chunk, statement->IfStatement.else_stmts);
+    emit_exit_scope(chunk, statement->IfStatement.else_stmts);
+    patch_jump(chunk, else_jump);
+    break;
+  case ASSIGNMENT:
+    compile_expression(chunk, statement->Assignment.right);
+    emit_store(chunk, statement->Assignment.left);
+    break;
+  case LOCAL_ASSIGNMENT:
+    compile_expression(chunk, &statement->LocalAssignment.right);
+    emit_store(chunk, &statement->LocalAssignment.left);
+    break;
+  case WHILE:
+    emit_enter_scope(chunk, statement->While.stmts);
+    loop = chunk->code_len;
+    compile_expression(chunk, statement->While.test);
+    jump = emit(chunk, OP_JMPZ, 0);
+    compile_statements(chunk, statement->While.stmts);
+    emit(chunk, OP_JMP, loop);
+    patch_jump(chunk, jump);
+    emit_exit_scope(chunk, statement->While.stmts);
+    break;
+  case FOR:;
+    // The loop keeps start, stop, step and the running counter on the stack,
+    // so assignments to the loop variable inside the body don't change the
+    // number of iterations. The loop leaves its last counter on the stack to
+    // store into the variable, which then holds the value that ended the
+    // loop, as in the other engines.
+    emit_enter_scope(chunk, statement->For.stmts);
+    compile_expression(chunk, statement->For.start);
+    emit(chunk, OP_DUP, 0);
+    emit_store(chunk, statement->For.identifier);
+    compile_expression(chunk, statement->For.stop);
+    compile_expression(chunk, statement->For.step);
+    jump = emit(chunk, OP_FOR_PREP, 0);
+    loop = emit(chunk, OP_DUP, 0);
+    emit_store(chunk, statement->For.identifier);
+    compile_statements(chunk, statement->For.stmts);
+    emit(chunk, OP_FOR_LOOP, loop);
+    emit_store(chunk, statement->For.identifier);
+    patch_jump(chunk, jump);
+    emit_exit_scope(chunk, statement->For.stmts);
+    break;
+  case PARAMETER:
+    break;
+  case STATEMENT_FUNCTION_CALL:
+    compile_expression(chunk, statement->FunctionCall.expr);
+    emit(chunk, OP_POP, 0);
+    break;
+  case FUNCTION_DECLARATION:
+    jump = emit(chunk, OP_JMP, 0);
+    statement->FunctionDeclaration.entry = chunk->code_len;
+    compile_statements(chunk, statement->FunctionDeclaration.stmts);
+    emit_constant(chunk, (InterpretResult){.type = NONE});
+    emit(chunk, OP_RTS, 0);
+    patch_jump(chunk, jump);
+    emit(chunk, OP_DEFINE_FUNC, add_function(chunk, statement));
+    break;
+  case RET:
+    compile_expression(chunk, &statement->Return.val);
+    emit(chunk, OP_RTS, 0);
+    break;
+  }
+}
+
+void compile_statements(Chunk *chunk, Statements *stmts) {
+  Statement *current_stmt = stmts->head;
+  while (current_stmt != NULL) {
+    compile_statement(chunk, current_stmt);
+    current_stmt = current_stmt->next;
+  }
+}
+
+Chunk compile(Node node) {
+  Chunk chunk = {0};
+  switch (node.type) {
+  case EXPR:
+    compile_expression(&chunk, node.expr);
+    break;
+  case STMT:
+    compile_statement(&chunk, node.stmt);
+    break;
+  case STMTS:
+    emit_enter_scope(&chunk, node.stmts);
+    compile_statements(&chunk, node.stmts);
+    emit_exit_scope(&chunk, node.stmts);
+    break;
+  }
+  emit(&chunk, OP_HALT, 0);
+  return chunk;
+}
+
+void free_chunk(Chunk *chunk) {
+  free(chunk->code);
+  free(chunk->constants);
+  free(chunk->calls);
+  free(chunk->functions);
+  *chunk = (Chunk){0};
+}
+
+char *opcode_string(enum OPCODE opcode) {
+  switch (opcode) {
+  case OP_PUSH:
+    return "PUSH";
+  case OP_POP:
+    return "POP";
+  case OP_DUP:
+    return "DUP";
+  case OP_LOAD_LOCAL:
+    return "LOAD_LOCAL";
+  case OP_LOAD_VAR:
+    return "LOAD_VAR";
+  case OP_STORE_LOCAL:
+    return "STORE_LOCAL";
+  case OP_STORE_VAR:
+    return "STORE_VAR";
+  case OP_ADD:
+    return "ADD";
+  case OP_SUB:
+    return "SUB";
+  case OP_MUL:
+    return "MUL";
+  case OP_DIV:
+    return "DIV";
+  case OP_MOD:
+    return "MOD";
+  case OP_EXP:
+    return "EXP";
+  case OP_EQ:
+    return "EQ";
+  case OP_NE:
+    return "NE";
+  case OP_LT:
+    return "LT";
+  case OP_GT:
+    return "GT";
+  case OP_LE:
+    return "LE";
+  case OP_GE:
+    return "GE";
+  case OP_NEG:
+    return "NEG";
+  case OP_NOT:
+    return "NOT";
+  case OP_AND:
+    return "AND";
+  case OP_OR:
+    return "OR";
+  case OP_JMP:
+    return "JMP";
+  case OP_JMPZ:
+    return "JMPZ";
+  case OP_ENTER_SCOPE:
+    return "ENTER_SCOPE";
+  case OP_EXIT_SCOPE:
+    return "EXIT_SCOPE";
+  case OP_FOR_PREP:
+    return "FOR_PREP";
+  case OP_FOR_LOOP:
+    return "FOR_LOOP";
+  case OP_DEFINE_FUNC:
+    return "DEFINE_FUNC";
+  case OP_CALL:
+    return "CALL";
+  case OP_RTS:
+    return "RTS";
+  case OP_PRINT:
+    return "PRINT";
+  case OP_PRINTLN:
+    return "PRINTLN";
+  case OP_HALT:
+    return "HALT";
+  }
+  assert("Unknown opcode");
+  return "shouldn't get as a return";
+}
+
+void chunk_print(Chunk *chunk) {
+  for (unsigned int i = 0; i < chunk->code_len; i++) {
+    Instruction instruction = chunk->code[i];
+    unsigned int operand = OPERAND(instruction);
+    printf("%04u\t%s", i, opcode_string(OPCODE(instruction)));
+    switch (OPCODE(instruction)) {
+    case OP_PUSH:
+      printf(" ");
+      interpret_result_print(&chunk->constants[operand], "");
+      break;
+    case OP_LOAD_VAR:
+    case OP_STORE_VAR:
+      printf(" %u %u", VARIABLE_DEPTH(operand), VARIABLE_SLOT(operand));
+      break;
+    case OP_LOAD_LOCAL:
+    case OP_STORE_LOCAL:
+      printf(" %u", operand);
+      break;
+    case OP_ENTER_SCOPE:
+      printf(" %u %u", SCOPE_VARS(operand), SCOPE_FUNCS(operand));
+      break;
+    case OP_CALL:
+      printf(" %.*s/%u", symbol_get(chunk->calls[operand].symbol)->len,
+             symbol_get(chunk->calls[operand].symbol)->name,
+             chunk->calls[operand].argc);
+      break;
+    case OP_DEFINE_FUNC:
+      printf(" %.*s",
+             chunk->functions[operand]->FunctionDeclaration.name_len,
+             chunk->functions[operand]->FunctionDeclaration.name);
+      break;
+    case OP_AND:
+    case OP_OR:
+    case OP_JMP:
+    case OP_JMPZ:
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+      printf(" %04u", operand);
+      break;
+    default:
+      break;
+    }
+    puts("");
+  }
+}
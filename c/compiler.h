@@ -0,0 +1,104 @@
+#pragma once
+
+#include "model.h"
+
+enum OPCODE {
+  OP_PUSH,
+  OP_POP,
+  OP_DUP,
+  OP_LOAD_LOCAL,
+  OP_LOAD_VAR,
+  OP_STORE_LOCAL,
+  OP_STORE_VAR,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_EXP,
+  OP_EQ,
+  OP_NE,
+  OP_LT,
+  OP_GT,
+  OP_LE,
+  OP_GE,
+  OP_NEG,
+  OP_NOT,
+  OP_AND,
+  OP_OR,
+  OP_JMP,
+  OP_JMPZ,
+  OP_ENTER_SCOPE,
+  OP_EXIT_SCOPE,
+  OP_FOR_PREP,
+  OP_FOR_LOOP,
+  OP_DEFINE_FUNC,
+  OP_CALL,
+  OP_RTS,
+  OP_PRINT,
+  OP_PRINTLN,
+  OP_HALT,
+};
+
+#define OPCODES (OP_HALT + 1)
+
+// Instructions are packed into 32 bits: the opcode in the low byte and a
+// single operand (constant, slot, call site index or jump target) above it.
+typedef unsigned int Instruction;
+
+#define INSTRUCTION(op, arg) ((Instruction)(op) | ((Instruction)(arg) << 8))
+#define OPCODE(instruction) ((instruction) & 0xff)
+#define OPERAND(instruction) ((instruction) >> 8)
+
+// LOAD_VAR and STORE_VAR address a slot `depth` scopes up the chain.
+#define VARIABLE(depth, slot) (((depth) << 16) | (slot))
+#define VARIABLE_DEPTH(operand) ((operand) >> 16)
+#define VARIABLE_SLOT(operand) ((operand) & 0xffff)
+
+// ENTER_SCOPE carries the number of variables and functions of the block.
+#define SCOPE(vars, funcs) (((funcs) << 16) | (vars))
+#define SCOPE_VARS(operand) ((operand) & 0xffff)
+#define SCOPE_FUNCS(operand) ((operand) >> 16)
+
+typedef struct CallSite CallSite;
+typedef struct Chunk Chunk;
+
+struct CallSite {
+  unsigned int symbol;
+  unsigned int argc;
+  CallCache cache;
+};
+
+struct Chunk {
+  Instruction *code;
+  unsigned int code_len;
+  unsigned int code_cap;
+  InterpretResult *constants;
+  unsigned int constants_len;
+  unsigned int constants_cap;
+  CallSite *calls;
+  unsigned int calls_len;
+  unsigned int calls_cap;
+  Statement **functions;
+  unsigned int functions_len;
+  unsigned int functions_cap;
+};
+
+Chunk compile(Node node);
+void compile_expression(Chunk *chunk, Expression *expression);
+void compile_statement(Chunk *chunk, Statement *statement);
+void compile_statements(Chunk *chunk, Statements *stmts);
+unsigned int emit(Chunk *chunk, enum OPCODE opcode, unsigned int operand);
+void patch_jump(Chunk *chunk, unsigned int jump);
+unsigned int add_constant(Chunk *chunk, InterpretResult constant);
+unsigned int emit_constant(Chunk *chunk, InterpretResult constant);
+unsigned int emit_load(Chunk *chunk, Expression *identifier);
+unsigned int emit_store(Chunk *chunk, Expression *identifier);
+void emit_enter_scope(Chunk *chunk, Statements *stmts);
+void emit_exit_scope(Chunk *chunk, Statements *stmts);
+unsigned int add_call(Chunk *chunk, Expression *call);
+unsigned int add_function(Chunk *chunk, Statement *function);
+enum OPCODE operator_opcode(TokenType token_type);
+void free_chunk(Chunk *chunk);
+void chunk_print(Chunk *chunk);
+char *opcode_string(enum OPCODE opcode);
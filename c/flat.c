@@ -0,0 +1,512 @@
+#include "flat.h"
+#include "buffer.h"
+#include "interpreter.h"
+#include "memory.h"
+#include "model.h"
+#include "state.h"
+#include "stats.h"
+#include "vm.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reserves `count` consecutive zeroed nodes and returns the first one. Nodes
+// move when the array grows, so they are only ever referred to by index.
+unsigned int flat_reserve(FlatAst *ast, unsigned int count) {
+  if (ast->nodes_len + count > ast->nodes_cap) {
+    while (ast->nodes_len + count > ast->nodes_cap)
+      ast->nodes_cap = ast->nodes_cap == 0 ? 256 : ast->nodes_cap * 2;
+    ast->nodes = realloc(ast->nodes, ast->nodes_cap * sizeof(FlatNode));
+  }
+  unsigned int first = ast->nodes_len;
+  memset(ast->nodes + first, 0, count * sizeof(FlatNode));
+  ast->nodes_len += count;
+  return first;
+}
+
+unsigned short flat_depth(int depth) {
+  return depth == UNRESOLVED ? FLAT_UNRESOLVED : depth;
+}
+
+unsigned int flat_count(Statements *stmts) {
+  unsigned int count = 0;
+  for (Statement *stmt = stmts->head; stmt != NULL; stmt = stmt->next)
+    count++;
+  return count;
+}
+
+void flatten_expression(FlatAst *ast, Expression *expression,
+                        unsigned int at);
+
+// Flattens an expression into a node of its own and returns its index.
+unsigned int flatten_child(FlatAst *ast, Expression *expression) {
+  unsigned int at = flat_reserve(ast, 1);
+  flatten_expression(ast, expression, at);
+  return at;
+}
+
+void flatten_expression(FlatAst *ast, Expression *expression,
+                        unsigned int at) {
+  FlatNode node = {0};
+  switch (expression->type) {
+  case INTEGER:
+    node.kind = FLAT_INT;
+    node.integer = expression->Integer.value;
+    break;
+  case FLOAT:
+    node.kind = FLAT_NUMBER;
+    node.number = expression->Float.value;
+    break;
+  case BOOL:
+    node.kind = FLAT_BOOL;
+    node.a = expression->Bool.value;
+    break;
+  case STRING:
+    GROW(ast->strings, ast->strings_len, ast->strings_cap);
+    ast->strings[ast->strings_len] =
+        (InterpretResult){.type = STR,
+                          .symbol = expression->String.symbol,
+                          .len = expression->String.len,
+                          .String.value = expression->String.value};
+    node.kind = FLAT_STRING;
+    node.a = ast->strings_len++;
+    break;
+  case IDENTIFIER:
+    node.kind = FLAT_IDENTIFIER;
+    node.depth = flat_depth(expression->Identifier.depth);
+    node.b = expression->Identifier.slot;
+    break;
+  case GROUPING:
+    flatten_expression(ast, expression->Grouping.exp, at);
+    return;
+  case UNARY_OP:
+    node.kind = FLAT_UNARY;
+    node.op = expression->UnaryOp.op.token_type;
+    node.a = flatten_child(ast, expression->UnaryOp.exp);
+    break;
+  case LOGICAL_OP:
+  case BINARY_OP:
+  case BINARY_INT:
+  case BINARY_NUMBER:
+  case BINARY_STRING:
+    // Comparisons are parsed as logical operators too; only `and` and `or`
+    // short-circuit.
+    node.op = expression->BinaryOp.op.token_type;
+    node.kind = node.op == TokAnd || node.op == TokOr ? FLAT_LOGICAL
+                                                      : FLAT_BINARY;
+    node.a = flatten_child(ast, expression->BinaryOp.left);
+    node.b = flatten_child(ast, expression->BinaryOp.right);
+    break;
+  case FUNCTION_CALL:;
+    Expressions *args = expression->FunctionCall.args;
+    GROW(ast->calls, ast->calls_len, ast->calls_cap);
+    ast->calls[ast->calls_len] =
+        (CallSite){expression->FunctionCall.symbol, args->length};
+    node.kind = FLAT_CALL;
+    node.b = ast->calls_len++;
+    node.a = flat_reserve(ast, args->length);
+    Expression *arg = args->head;
+    for (int i = 0; i < args->length; i++, arg = arg->next)
+      flatten_expression(ast, arg, node.a + i);
+    break;
+  }
+  ast->nodes[at] = node;
+}
+
+unsigned int flatten_block(FlatAst *ast, Statements *stmts);
+
+void flatten_statement(FlatAst *ast, Statement *statement, unsigned int at) {
+  FlatNode node = {0};
+  switch (statement->type) {
+  case PRINT:
+    node.kind = FLAT_PRINT;
+    node.a = flatten_child(ast, statement->PrintStatement.value);
+    break;
+  case PRINTLN:
+    node.kind = FLAT_PRINTLN;
+    node.a = flatten_child(ast, statement->PrintlnStatement.value);
+    break;
+  case RET:
+    node.kind = FLAT_RET;
+    node.a = flatten_child(ast, &statement->Return.val);
+    break;
+  case STATEMENT_FUNCTION_CALL:
+    node.kind = FLAT_EXPRESSION;
+    node.a = flatten_child(ast, statement->FunctionCall.expr);
+    break;
+  case ASSIGNMENT:
+    assert(statement->Assignment.left->type == IDENTIFIER);
+    node.kind = FLAT_ASSIGN;
+    node.depth = flat_depth(statement->Assignment.left->Identifier.depth);
+    node.a = flatten_child(ast, statement->Assignment.right);
+    node.b = statement->Assignment.left->Identifier.slot;
+    break;
+  case LOCAL_ASSIGNMENT:
+    assert(statement->LocalAssignment.left.type == IDENTIFIER);
+    node.kind = FLAT_ASSIGN;
+    node.a = flatten_child(ast, &statement->LocalAssignment.right);
+    node.b = statement->LocalAssignment.left.Identifier.slot;
+    break;
+  case IF:
+    node.kind = FLAT_IF;
+    node.a = flatten_child(ast, statement->IfStatement.test);
+    node.b = flatten_block(ast, statement->IfStatement.then_stmts);
+    node.c = flatten_block(ast, statement->IfStatement.else_stmts);
+    break;
+  case WHILE:
+    node.kind = FLAT_WHILE;
+    node.a = flatten_child(ast, statement->While.test);
+    node.b = flatten_block(ast, statement->While.stmts);
+    break;
+  case FOR:
+    node.kind = FLAT_FOR;
+    node.a = flat_reserve(ast, 4);
+    flatten_expression(ast, statement->For.identifier, node.a);
+    flatten_expression(ast, statement->For.start, node.a + 1);
+    flatten_expression(ast, statement->For.stop, node.a + 2);
+    flatten_expression(ast, statement->For.step, node.a + 3);
+    node.b = flatten_block(ast, statement->For.stmts);
+    break;
+  case FUNCTION_DECLARATION:
+    statement->FunctionDeclaration.entry =
+        flatten_block(ast, statement->FunctionDeclaration.stmts);
+    GROW(ast->functions, ast->functions_len, ast->functions_cap);
+    ast->functions[ast->functions_len] = statement;
+    node.kind = FLAT_FUNCTION;
+    node.a = ast->functions_len++;
+    node.b = statement->FunctionDeclaration.slot;
+    break;
+  case PARAMETER:
+    node.kind = FLAT_NOP;
+    break;
+  }
+  ast->nodes[at] = node;
+}
+
+// The statements of a block take consecutive nodes, their children follow.
+unsigned int flatten_block(FlatAst *ast, Statements *stmts) {
+  unsigned int count = flat_count(stmts);
+  unsigned int first = flat_reserve(ast, count);
+  GROW(ast->blocks, ast->blocks_len, ast->blocks_cap);
+  unsigned int block = ast->blocks_len++;
+  ast->blocks[block] = (FlatBlock){first, count, stmts->scope_size,
+                                   stmts->funcs_size, stmts->has_scope};
+  Statement *stmt = stmts->head;
+  for (unsigned int i = 0; i < count; i++, stmt = stmt->next)
+    flatten_statement(ast, stmt, first + i);
+  return block;
+}
+
+FlatAst flatten(Node node) {
+  FlatAst ast = {0};
+  if (node.type != STMTS) {
+    puts("Only whole programs can be flattened");
+    exit(EXIT_FAILURE);
+  }
+  ast.root = flatten_block(&ast, node.stmts);
+  return ast;
+}
+
+size_t flat_bytes(FlatAst *ast) {
+  return ast->nodes_len * sizeof(FlatNode) +
+         ast->blocks_len * sizeof(FlatBlock) +
+         ast->strings_len * sizeof(InterpretResult) +
+         ast->calls_len * sizeof(CallSite) +
+         ast->functions_len * sizeof(Statement *);
+}
+
+void free_flat(FlatAst *ast) {
+  free(ast->nodes);
+  free(ast->blocks);
+  free(ast->strings);
+  free(ast->calls);
+  free(ast->functions);
+}
+
+char *flat_kind_string(enum FLAT_KIND kind) {
+  switch (kind) {
+  case FLAT_INT:
+    return "INT";
+  case FLAT_NUMBER:
+    return "NUMBER";
+  case FLAT_BOOL:
+    return "BOOL";
+  case FLAT_STRING:
+    return "STRING";
+  case FLAT_IDENTIFIER:
+    return "IDENTIFIER";
+  case FLAT_UNARY:
+    return "UNARY";
+  case FLAT_BINARY:
+    return "BINARY";
+  case FLAT_LOGICAL:
+    return "LOGICAL";
+  case FLAT_CALL:
+    return "CALL";
+  case FLAT_PRINT:
+    return "PRINT";
+  case FLAT_PRINTLN:
+    return "PRINTLN";
+  case FLAT_RET:
+    return "RET";
+  case FLAT_EXPRESSION:
+    return "EXPRESSION";
+  case FLAT_ASSIGN:
+    return "ASSIGN";
+  case FLAT_IF:
+    return "IF";
+  case FLAT_WHILE:
+    return "WHILE";
+  case FLAT_FOR:
+    return "FOR";
+  case FLAT_FUNCTION:
+    return "FUNCTION";
+  case FLAT_NOP:
+    return "NOP";
+  }
+  return "UNKNOWN";
+}
+
+typedef struct FlatInterpreter FlatInterpreter;
+
+struct FlatInterpreter {
+  FlatAst *ast;
+  Arena *arena;
+  Arena *scratch;
+  Arena *hashmap_arena;
+};
+
+bool flat_block(FlatInterpreter *self, unsigned int block, State *state,
+                InterpretResult *ret);
+
+InterpretResult flat_expression(FlatInterpreter *self, unsigned int index,
+                                State *state) {
+  FlatNode *node = &self->ast->nodes[index];
+  InterpretResult left;
+  InterpretResult right;
+  COUNT(flat_evaluated[node->kind]);
+  switch (node->kind) {
+  case FLAT_INT:
+    return (InterpretResult){.type = INT, .Int.value = node->integer};
+  case FLAT_NUMBER:
+    return (InterpretResult){.type = NUMBER, .Number.value = node->number};
+  case FLAT_BOOL:
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = node->a};
+  case FLAT_STRING:
+    return self->ast->strings[node->a];
+  case FLAT_IDENTIFIER:
+    if (node->depth == FLAT_UNRESOLVED)
+      return (InterpretResult){.type = NONE};
+    return state_get(state, node->depth, node->b);
+  case FLAT_UNARY:
+    right = flat_expression(self, node->a, state);
+    if (node->op == TokMinus && right.type == INT)
+      right.Int.value = WRAP(0, -, right.Int.value);
+    else if (node->op == TokMinus && right.type == NUMBER)
+      right.Number.value = -right.Number.value;
+    else if (node->op == TokNot)
+      right = (InterpretResult){.type = BOOLEAN,
+                                .Bool.value = !is_truthy(&right)};
+    return right;
+  case FLAT_LOGICAL:
+    left = flat_expression(self, node->a, state);
+    if (node->op == TokOr && is_truthy(&left))
+      return (InterpretResult){.type = BOOLEAN, .Bool.value = true};
+    if (node->op == TokAnd && !is_truthy(&left))
+      return (InterpretResult){.type = BOOLEAN, .Bool.value = false};
+    return flat_expression(self, node->b, state);
+  case FLAT_BINARY:
+    left = flat_expression(self, node->a, state);
+    right = flat_expression(self, node->b, state);
+    if (left.type == INT && right.type == INT) {
+      switch (node->op) {
+      case TokPlus:
+        left.Int.value = WRAP(left.Int.value, +, right.Int.value);
+        return left;
+      case TokMinus:
+        left.Int.value = WRAP(left.Int.value, -, right.Int.value);
+        return left;
+      case TokStar:
+        left.Int.value = WRAP(left.Int.value, *, right.Int.value);
+        return left;
+      case TokMod:
+        left.Int.value = integer_mod(left.Int.value, right.Int.value);
+        return left;
+      case TokLt:
+        return (InterpretResult){
+            .type = BOOLEAN, .Bool.value = left.Int.value < right.Int.value};
+      default:
+        break;
+      }
+    } else if (left.type == NUMBER && right.type == NUMBER) {
+      switch (node->op) {
+      case TokPlus:
+        left.Number.value += right.Number.value;
+        return left;
+      case TokMinus:
+        left.Number.value -= right.Number.value;
+        return left;
+      case TokStar:
+        left.Number.value *= right.Number.value;
+        return left;
+      case TokLt:
+        return (InterpretResult){
+            .type = BOOLEAN,
+            .Bool.value = left.Number.value < right.Number.value};
+      default:
+        break;
+      }
+    }
+    return binary_op(node->op, left, right, self->scratch);
+  case FLAT_CALL:;
+    CallSite *call = &self->ast->calls[node->b];
+    State *owner;
+    Statement *function =
+        state_func_cached(state, call->symbol, call->argc, &call->cache,
+                          &owner);
+    FlatBlock *body = &self->ast->blocks[function->FunctionDeclaration.entry];
+    call_depth++;
+    State func_state =
+        state_new(owner, self->hashmap_arena, body->vars_size,
+                  body->funcs_size);
+    for (unsigned int i = 0; i < call->argc; i++) {
+      InterpretResult arg = flat_expression(self, node->a + i, state);
+      state_set(&func_state, 0, i, arg);
+    }
+    InterpretResult value = {.type = NONE};
+    flat_block(self, function->FunctionDeclaration.entry, &func_state,
+               &value);
+    free_state(&func_state, self->hashmap_arena);
+    call_depth--;
+    return value;
+  default:
+    assert("Shouldn't reach here");
+  }
+  return (InterpretResult){.type = NONE};
+}
+
+// Like state_enter: blocks that declare nothing run in `state`.
+State *flat_enter(FlatInterpreter *self, unsigned int block, State *state,
+                  State *scope) {
+  FlatBlock *info = &self->ast->blocks[block];
+  if (!info->has_scope)
+    return state;
+  *scope =
+      state_new(state, self->hashmap_arena, info->vars_size, info->funcs_size);
+  return scope;
+}
+
+// Like interpret_statement: returns true once a `ret` ran, with its value in
+// `ret`.
+bool flat_statement(FlatInterpreter *self, unsigned int index, State *state,
+                    InterpretResult *ret) {
+  FlatNode *node = &self->ast->nodes[index];
+  InterpretResult res;
+  COUNT(flat_evaluated[node->kind]);
+  switch (node->kind) {
+  case FLAT_PRINT:
+    res = flat_expression(self, node->a, state);
+    interpret_result_print(&res, "");
+    return false;
+  case FLAT_PRINTLN:
+    res = flat_expression(self, node->a, state);
+    interpret_result_print(&res, "\n");
+    return false;
+  case FLAT_RET:
+    *ret = buffer_detach(flat_expression(self, node->a, state),
+                         self->scratch);
+    return true;
+  case FLAT_EXPRESSION:
+    flat_expression(self, node->a, state);
+    return false;
+  case FLAT_ASSIGN:
+    res = flat_expression(self, node->a, state);
+    state_set(state, node->depth, node->b, res);
+    return false;
+  case FLAT_IF:;
+    res = flat_expression(self, node->a, state);
+    unsigned int branch = is_truthy(&res) ? node->b : node->c;
+    State scope;
+    State *branch_state = flat_enter(self, branch, state, &scope);
+    bool returned = flat_block(self, branch, branch_state, ret);
+    state_exit(state, branch_state, self->hashmap_arena);
+    return returned;
+  case FLAT_WHILE:;
+    State *while_state = flat_enter(self, node->b, state, &scope);
+    size_t mark = self->scratch->pointer;
+    returned = false;
+    while (1) {
+      res = flat_expression(self, node->a, while_state);
+      if (!is_truthy(&res))
+        break;
+      if (flat_block(self, node->b, while_state, ret)) {
+        returned = true;
+        break;
+      }
+      scratch_release(self->scratch, mark);
+    }
+    state_exit(state, while_state, self->hashmap_arena);
+    return returned;
+  case FLAT_FOR:;
+    State *for_state = flat_enter(self, node->b, state, &scope);
+    FlatNode *identifier = &self->ast->nodes[node->a];
+    InterpretResult start = flat_expression(self, node->a + 1, for_state);
+    state_set(for_state, identifier->depth, identifier->b, start);
+    InterpretResult stop = flat_expression(self, node->a + 2, for_state);
+    InterpretResult step = flat_expression(self, node->a + 3, for_state);
+    returned = false;
+    while (1) {
+      InterpretResult current =
+          state_get(for_state, identifier->depth, identifier->b);
+      if (for_done(&start, &stop, &current))
+        break;
+      if (flat_block(self, node->b, for_state, ret)) {
+        returned = true;
+        break;
+      }
+      for_step(&current, &step);
+      state_set(for_state, identifier->depth, identifier->b, current);
+    }
+    state_exit(state, for_state, self->hashmap_arena);
+    return returned;
+  case FLAT_FUNCTION:
+    state_func_set(state, node->b, self->ast->functions[node->a]);
+    return false;
+  case FLAT_NOP:
+    return false;
+  }
+  return false;
+}
+
+// Runs the statements of a block in `state`, releasing each statement's
+// temporaries after it.
+bool flat_block(FlatInterpreter *self, unsigned int block, State *state,
+                InterpretResult *ret) {
+  FlatBlock *info = &self->ast->blocks[block];
+  unsigned int end = info->first + info->count;
+  for (unsigned int i = info->first; i < end; i++) {
+    size_t mark = self->scratch->pointer;
+    if (flat_statement(self, i, state, ret))
+      return true;
+    scratch_release(self->scratch, mark);
+  }
+  return false;
+}
+
+InterpretResult flat_interpret(FlatAst *ast, Arena *arena) {
+  Arena hashmap_arena = new_arena();
+  Arena scratch = new_arena();
+  FlatInterpreter self = {ast, arena, &scratch, &hashmap_arena};
+  FlatBlock *root = &ast->blocks[ast->root];
+  State state =
+      state_new(NULL, &hashmap_arena, root->vars_size, root->funcs_size);
+  InterpretResult res = {.type = NONE};
+  flat_block(&self, ast->root, &state, &res);
+  res = escape_value(res, &scratch, arena);
+  free_state(&state, &hashmap_arena);
+  scratch_release(&scratch, 0);
+  munmap(scratch.memory, ARENA_SIZE);
+  munmap(hashmap_arena.memory, ARENA_SIZE);
+  return res;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "compiler.h"
+#include "memory.h"
+#include "model.h"
+#include "state.h"
+#include <stdbool.h>
+
+// A resolved program as one array of 16 byte nodes that refer to each other
+// by index. Only what evaluation touches on every visit lives in a node;
+// string constants, call sites and block scopes are kept in side tables.
+//
+//   INT         integer
+//   NUMBER      number
+//   BOOL        a: value
+//   STRING      a: index into `strings`
+//   IDENTIFIER  depth, b: slot
+//   UNARY       op, a: operand
+//   BINARY      op, a: left, b: right (also LOGICAL)
+//   CALL        a: first argument, b: index into `calls`
+//   PRINT       a: value (also PRINTLN, RET and EXPRESSION)
+//   ASSIGN      depth, a: value, b: slot
+//   IF          a: test, b: then block, c: else block
+//   WHILE       a: test, b: block
+//   FOR         a: identifier, start, stop and step in a row, b: block
+//   FUNCTION    a: index into `functions`, b: slot
+//
+// The arguments of a call and the statements of a block are consecutive.
+
+enum FLAT_KIND {
+  FLAT_INT,
+  FLAT_NUMBER,
+  FLAT_BOOL,
+  FLAT_STRING,
+  FLAT_IDENTIFIER,
+  FLAT_UNARY,
+  FLAT_BINARY,
+  FLAT_LOGICAL,
+  FLAT_CALL,
+  FLAT_PRINT,
+  FLAT_PRINTLN,
+  FLAT_RET,
+  FLAT_EXPRESSION,
+  FLAT_ASSIGN,
+  FLAT_IF,
+  FLAT_WHILE,
+  FLAT_FOR,
+  FLAT_FUNCTION,
+  FLAT_NOP,
+};
+
+#define FLAT_KINDS (FLAT_NOP + 1)
+
+// Depth of an identifier the resolver couldn't bind.
+#define FLAT_UNRESOLVED 0xffff
+
+typedef struct FlatNode FlatNode;
+typedef struct FlatBlock FlatBlock;
+typedef struct FlatAst FlatAst;
+
+struct FlatNode {
+  unsigned char kind;
+  // The operator's TokenType.
+  unsigned char op;
+  unsigned short depth;
+  unsigned int a;
+  union {
+    struct {
+      unsigned int b;
+      unsigned int c;
+    };
+    long integer;
+    double number;
+  };
+};
+
+struct FlatBlock {
+  unsigned int first;
+  unsigned int count;
+  unsigned int vars_size;
+  unsigned int funcs_size;
+  bool has_scope;
+};
+
+// Function declarations are kept as statements, because that is what
+// scopes hold; their `entry` is the block of their body.
+struct FlatAst {
+  FlatNode *nodes;
+  long nodes_len;
+  long nodes_cap;
+  FlatBlock *blocks;
+  long blocks_len;
+  long blocks_cap;
+  InterpretResult *strings;
+  long strings_len;
+  long strings_cap;
+  CallSite *calls;
+  long calls_len;
+  long calls_cap;
+  Statement **functions;
+  long functions_len;
+  long functions_cap;
+  unsigned int root;
+};
+
+FlatAst flatten(Node node);
+size_t flat_bytes(FlatAst *ast);
+void free_flat(FlatAst *ast);
+char *flat_kind_string(enum FLAT_KIND kind);
+InterpretResult flat_interpret(FlatAst *ast, Arena *arena);
@@ -1,9 +1,17 @@
 #include "interpreter.h"
+#include "buffer.h"
 #include "memory.h"
 #include "model.h"
+#include "number.h"
+#include "output.h"
+#include "profile.h"
 #include "state.h"
+#include "stats.h"
+#include "symbols.h"
 #include "tokens.h"
+#include "vm.h"
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,433 +20,680 @@
 
 InterpretResult interpret_ast(Node node, Arena *arena) {
   Arena hashmap_arena = new_arena();
-  State state = state_new(NULL, &hashmap_arena);
-  InterpretResult res = interpret(node, &state, arena, &hashmap_arena);
+  Arena scratch = new_arena();
+  State state = node.type == STMTS
+                    ? get_new_state(NULL, &hashmap_arena, node.stmts)
+                    : state_new(NULL, &hashmap_arena, 0, 0);
+  InterpretResult res =
+      interpret(node, &state, arena, &scratch, &hashmap_arena);
+  res = escape_value(res, &scratch, arena);
   free_state(&state, &hashmap_arena);
+  munmap(hashmap_arena.memory, ARENA_SIZE);
+  scratch_release(&scratch, 0);
+  munmap(scratch.memory, ARENA_SIZE);
   return res;
 }
 
+// Strings computed while evaluating a statement live in the scratch arena
+// until the statement ends. Values stored into variables are copied into
+// the variable's buffer (see buffer.h), and the program's result to `arena`.
+InterpretResult escape_value(InterpretResult value, Arena *scratch,
+                             Arena *arena) {
+  if (value.type != STR || !arena_contains(scratch, value.String.value))
+    return value;
+  char *copy = arena_alloc(arena, value.len + 1);
+  memcpy(copy, value.String.value, value.len);
+  copy[value.len] = '\0';
+  value.String.value = copy;
+  value.owned = false;
+  COUNT_ADD(escaped_bytes, value.len + 1);
+  return value;
+}
+
+// Every interpreter releases scratch between statements, which is when
+// retired string buffers can be freed.
+void scratch_release(Arena *scratch, size_t mark) {
+  if (scratch->pointer > stats.peak_scratch_bytes)
+    stats.peak_scratch_bytes = scratch->pointer;
+  scratch->pointer = mark;
+  if (retired.len != 0)
+    buffers_collect();
+}
+
+// Literals are interned, so two of them are equal exactly when their symbols
+// are. Strings built at run time are compared by content.
+bool string_equal(InterpretResult *left, InterpretResult *right) {
+  if (left->symbol != NO_SYMBOL && right->symbol != NO_SYMBOL)
+    return left->symbol == right->symbol;
+  return left->len == right->len &&
+         memcmp(left->String.value, right->String.value, left->len) == 0;
+}
+
+// Strings own `len + 1` bytes, the last one being the terminator. A string
+// at the top of the arena is grown in place: nothing else can refer to the
+// bytes past its end, so chained appends don't copy the left side again.
+// Strings in a variable's buffer grow in place too, if it has room.
+InterpretResult string_append(InterpretResult left, char *right,
+                              unsigned int len, Arena *arena) {
+  if (buffer_append(&left, right, len))
+    return left;
+  char *result = arena_realloc(arena, left.String.value, left.len + 1,
+                               left.len + len + 1);
+  memcpy(result + left.len, right, len);
+  result[left.len + len] = '\0';
+  return (InterpretResult){
+      .type = STR, .len = left.len + len, .String.value = result};
+}
+
+// A string repeats a whole number of times, the fraction of `count` dropped.
+// Counts below one give the empty string. NaN and counts that make the
+// string longer than a length can hold are errors.
+bool repeat_count_valid(InterpretResult *left, double count) {
+  return !isnan(count) &&
+         (left->len == 0 || count < (double)(UINT_MAX / left->len) + 1);
+}
+
+// Copies the string into its own tail, doubling the copied part each time.
+InterpretResult string_repeat(InterpretResult left, double count,
+                              Arena *arena) {
+  if (isnan(count))
+    runtime_error("Can't repeat a string NaN times");
+  if (!repeat_count_valid(&left, count))
+    runtime_error("A string of %u characters repeated %.0f times is too long",
+                  left.len, count);
+  unsigned int len =
+      count >= 1 && left.len != 0 ? left.len * (unsigned int)count : 0;
+  char *result = arena_realloc(arena, left.String.value, left.len + 1,
+                               (size_t)len + 1);
+  for (unsigned int filled = left.len; filled < len;) {
+    unsigned int copied = filled < len - filled ? filled : len - filled;
+    memcpy(result + filled, result, copied);
+    filled += copied;
+  }
+  result[len] = '\0';
+  return (InterpretResult){.type = STR, .len = len, .String.value = result};
+}
+
+// Booleans count as the integers 0 and 1 in arithmetic.
+bool is_integer(InterpretResult *value) {
+  return value->type == INT || value->type == BOOLEAN;
+}
+
+long integer_value(InterpretResult *value) {
+  return value->type == INT ? value->Int.value : value->Bool.value;
+}
+
+double number_value(InterpretResult *value) {
+  return value->type == NUMBER ? value->Number.value
+                               : (double)integer_value(value);
+}
+
+// The remainder takes the sign of the divisor, like Python's.
+long integer_mod(long left, long right) {
+  if (right == 0) {
+    runtime_error("Modulo by zero");
+  }
+  if (right == -1)
+    return 0;
+  long mod = left % right;
+  return mod != 0 && (mod < 0) != (right < 0) ? mod + right : mod;
+}
+
+double number_mod(double left, double right) {
+  double mod = fmod(left, right);
+  return mod != 0 && (mod < 0) != (right < 0) ? mod + right : mod;
+}
+
+// Exact for non-negative exponents, by squaring.
+InterpretResult integer_pow(long base, long exponent) {
+  if (exponent < 0)
+    return (InterpretResult){.type = NUMBER,
+                             .Number.value = pow(base, exponent)};
+  long result = 1;
+  for (; exponent > 0; exponent >>= 1) {
+    if (exponent & 1)
+      result = WRAP(result, *, base);
+    base = WRAP(base, *, base);
+  }
+  return (InterpretResult){.type = INT, .Int.value = result};
+}
+
+InterpretResult integer_op(TokenType op, long left, long right) {
+  switch (op) {
+  case (TokPlus):
+    return (InterpretResult){.type = INT, .Int.value = WRAP(left, +, right)};
+  case (TokMinus):
+    return (InterpretResult){.type = INT, .Int.value = WRAP(left, -, right)};
+  case (TokStar):
+    return (InterpretResult){.type = INT, .Int.value = WRAP(left, *, right)};
+  case (TokSlash):
+    return (InterpretResult){.type = NUMBER,
+                             .Number.value = (double)left / right};
+  case (TokMod):
+    return (InterpretResult){.type = INT,
+                             .Int.value = integer_mod(left, right)};
+  case (TokCaret):
+    return integer_pow(left, right);
+  case (TokEq):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left == right};
+  case (TokLe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left <= right};
+  case (TokGe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left >= right};
+  case (TokLt):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left < right};
+  case (TokGt):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left > right};
+  case (TokNe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left != right};
+  default:
+    assert("Shouldn't reach here");
+  }
+  return (InterpretResult){.type = NONE};
+}
+
+InterpretResult number_op(TokenType op, double left, double right) {
+  switch (op) {
+  case (TokPlus):
+    return (InterpretResult){.type = NUMBER, .Number.value = left + right};
+  case (TokMinus):
+    return (InterpretResult){.type = NUMBER, .Number.value = left - right};
+  case (TokStar):
+    return (InterpretResult){.type = NUMBER, .Number.value = left * right};
+  case (TokSlash):
+    return (InterpretResult){.type = NUMBER, .Number.value = left / right};
+  case (TokMod):
+    return (InterpretResult){.type = NUMBER,
+                             .Number.value = number_mod(left, right)};
+  case (TokCaret):
+    return (InterpretResult){.type = NUMBER,
+                             .Number.value = pow(left, right)};
+  case (TokEq):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left == right};
+  case (TokLe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left <= right};
+  case (TokGe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left >= right};
+  case (TokLt):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left < right};
+  case (TokGt):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left > right};
+  case (TokNe):
+    return (InterpretResult){.type = BOOLEAN, .Bool.value = left != right};
+  default:
+    assert("Shouldn't reach here");
+  }
+  return (InterpretResult){.type = NONE};
+}
+
+// Returns the length written, at most NUMBER_MAX.
+int number_format(InterpretResult *value, char *buffer) {
+  if (value->type == INT)
+    return format_long(buffer, value->Int.value);
+  return format_double(buffer, value->Number.value);
+}
+
+InterpretResult binary_op(TokenType op, InterpretResult left,
+                          InterpretResult right, Arena *arena) {
+  if (left.type == NUMBER && right.type == NUMBER)
+    return number_op(op, left.Number.value, right.Number.value);
+  if (is_integer(&left) && is_integer(&right))
+    return integer_op(op, integer_value(&left), integer_value(&right));
+  if ((is_integer(&left) || left.type == NUMBER) &&
+      (is_integer(&right) || right.type == NUMBER))
+    return number_op(op, number_value(&left), number_value(&right));
+  if (left.type == STR && right.type == STR) {
+    if (op == TokPlus)
+      return string_append(left, right.String.value, right.len, arena);
+    if (op == TokEq) {
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = string_equal(&left, &right)};
+    }
+    if (op == TokNe) {
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = !string_equal(&left, &right)};
+    }
+    assert("Shouldn't reach here");
+  }
+  if (left.type == STR && (right.type == INT || right.type == NUMBER)) {
+    if (op == TokPlus) {
+      char number[NUMBER_MAX];
+      int len = number_format(&right, number);
+      return string_append(left, number, len, arena);
+    }
+    if (op == TokStar)
+      return string_repeat(left, number_value(&right), arena);
+    assert("Shouldn't reach here");
+  }
+  return (InterpretResult){.type = NONE};
+}
+
+// Binary operators specialise themselves on the operand types they see. A
+// node evaluated QUICKEN_AFTER times in a row with two integers, two doubles
+// or two strings becomes a BINARY_INT, BINARY_NUMBER or BINARY_STRING node,
+// which checks the types once and goes straight to the operation. When the
+// check fails the node turns back into a BINARY_OP; after QUICKEN_DEOPTS_MAX
+// times it stays one.
+#define QUICKEN_AFTER 8
+#define QUICKEN_DEOPTS_MAX 4
+
+void quicken(Expression *expression, InterpretResult *left,
+             InterpretResult *right) {
+  if (expression->deopts >= QUICKEN_DEOPTS_MAX)
+    return;
+  enum FEEDBACK seen =
+      left->type == INT && right->type == INT         ? FEEDBACK_INT
+      : left->type == NUMBER && right->type == NUMBER ? FEEDBACK_NUMBER
+      : left->type == STR && right->type == STR       ? FEEDBACK_STRING
+                                                      : FEEDBACK_MIXED;
+  if (seen != expression->seen) {
+    expression->seen = seen;
+    expression->runs = 0;
+  }
+  if (seen == FEEDBACK_MIXED || ++expression->runs < QUICKEN_AFTER)
+    return;
+  expression->type = seen == FEEDBACK_INT      ? BINARY_INT
+                     : seen == FEEDBACK_NUMBER ? BINARY_NUMBER
+                                               : BINARY_STRING;
+  COUNT(quickened_nodes);
+}
+
+InterpretResult deoptimize(Expression *expression, InterpretResult left,
+                           InterpretResult right, Arena *scratch) {
+  expression->type = BINARY_OP;
+  expression->seen = FEEDBACK_NONE;
+  expression->runs = 0;
+  expression->deopts++;
+  COUNT(deoptimized_nodes);
+  return binary_op(expression->BinaryOp.op.token_type, left, right, scratch);
+}
+
 InterpretResult interpret(Node node, State *state, Arena *arena,
-                          Arena *hashmap_arena) {
+                          Arena *scratch, Arena *hashmap_arena) {
+  InterpretResult result = {.type = NONE};
   switch (node.type) {
-  case EXPR:;
-    Expression *expression = node.expr;
-    InterpretResult left;
-    InterpretResult right;
-    switch (expression->type) {
+  case EXPR:
+    return interpret_expression(node.expr, state, arena, scratch,
+                                hashmap_arena);
+  case STMT:
+    interpret_statement(node.stmt, state, arena, scratch, hashmap_arena,
+                        &result);
+    break;
+  case STMTS:
+    interpret_statements(node.stmts, state, arena, scratch, hashmap_arena,
+                         &result);
+    break;
+  }
+  return result;
+}
 
-    case (FUNCTION_CALL):;
-      Statement *function = state_func_get(state, expression->FunctionCall.name,
-                                           expression->FunctionCall.name_len);
-      assert(function != NULL);
-      assert(function->FunctionDeclaration.params->length ==
-             expression->FunctionCall.args->length);
-      State func_state = get_new_state(state, hashmap_arena);
-      Statement *params_head = function->FunctionDeclaration.params->head;
-      Expression *args_head = expression->FunctionCall.args->head;
-      while (params_head != NULL) {
-        state_set_local(&func_state, params_head->Parameter.name,
-                        params_head->Parameter.name_len,
-                        interpret((Node){.type = EXPR, .expr = args_head},
-                                  state, arena, hashmap_arena));
-        params_head = params_head->next;
-        args_head = args_head->next;
-      }
-      InterpretResult func_exec_res = interpret(
-          (Node){.type = STMTS, .stmts = function->FunctionDeclaration.stmts},
-          &func_state, arena, hashmap_arena);
-      free_state(&func_state, hashmap_arena);
-      if (func_exec_res.type == RETURN)
-        return *func_exec_res.Return.ret;
-      return func_exec_res;
-    case (IDENTIFIER):;
-      return state_get(state, expression->Identifier.name,
-                       expression->Identifier.len);
-    case (GROUPING):
-      return interpret((Node){EXPR, .expr = expression->Grouping.exp}, state,
-                       arena, hashmap_arena);
-    case (INTEGER):
-      return (InterpretResult){.type = NUMBER,
-                               .Number.value = expression->Integer.value};
-    case (FLOAT):
-      return (InterpretResult){.type = NUMBER,
-                               .Number.value = expression->Float.value};
-    case (BOOL):
+InterpretResult interpret_expression(Expression *expression, State *state,
+                                     Arena *arena, Arena *scratch,
+                                     Arena *hashmap_arena) {
+  InterpretResult left;
+  InterpretResult right;
+  COUNT(evaluated_nodes);
+  COUNT(evaluated_expressions[expression->type]);
+  switch (expression->type) {
+
+  case (FUNCTION_CALL):;
+    State *owner;
+    Statement *function =
+        state_func_cached(state, expression->FunctionCall.symbol,
+                          expression->FunctionCall.args->length,
+                          &expression->FunctionCall.cache, &owner);
+    call_depth++;
+    State func_state = get_new_state(owner, hashmap_arena,
+                                     function->FunctionDeclaration.stmts);
+    Expression *args_head = expression->FunctionCall.args->head;
+    for (int i = 0; i < expression->FunctionCall.args->length; i++) {
+      InterpretResult arg = interpret_expression(args_head, state, arena,
+                                                 scratch, hashmap_arena);
+      state_set(&func_state, 0, i, arg);
+      args_head = args_head->next;
+    }
+    InterpretResult value = {.type = NONE};
+    if (profile.enabled)
+      profile_call_enter(function);
+    interpret_statements(function->FunctionDeclaration.stmts, &func_state,
+                         arena, scratch, hashmap_arena, &value);
+    if (profile.enabled)
+      profile_call_exit();
+    free_state(&func_state, hashmap_arena);
+    call_depth--;
+    return value;
+  case (IDENTIFIER):;
+    return state_get(state, expression->Identifier.depth,
+                     expression->Identifier.slot);
+  case (GROUPING):
+    return interpret_expression(expression->Grouping.exp, state, arena,
+                                scratch, hashmap_arena);
+  case (INTEGER):
+    return (InterpretResult){.type = INT,
+                             .Int.value = expression->Integer.value};
+  case (FLOAT):
+    return (InterpretResult){.type = NUMBER,
+                             .Number.value = expression->Float.value};
+  case (BOOL):
+    return (InterpretResult){.type = BOOLEAN,
+                             .Bool.value = expression->Bool.value};
+  case (STRING):
+    return (InterpretResult){.type = STR,
+                             .symbol = expression->String.symbol,
+                             .len = expression->String.len,
+                             .String.value = expression->String.value};
+
+  case (UNARY_OP):
+    right = interpret_expression(expression->UnaryOp.exp, state, arena,
+                                 scratch, hashmap_arena);
+    if (expression->UnaryOp.op.token_type == TokNot)
       return (InterpretResult){.type = BOOLEAN,
-                               .Bool.value = expression->Bool.value};
-    case (STRING):
-      return (InterpretResult){.type = STR,
-                               .String.value = expression->String.value,
-                               .String.len = expression->String.len,
-                               .String.alloced = false};
+                               .Bool.value = !is_truthy(&right)};
+    if (expression->UnaryOp.op.token_type == TokMinus && right.type == INT)
+      right.Int.value = WRAP(0, -, right.Int.value);
+    else if (expression->UnaryOp.op.token_type == TokMinus &&
+             right.type == NUMBER)
+      right.Number.value = -right.Number.value;
+    return right;
+  case (LOGICAL_OP):
+    // Comparisons are logical operators too, but only `and` and `or`
+    // short-circuit.
+    if (expression->LogicalOp.op.token_type == TokAnd ||
+        expression->LogicalOp.op.token_type == TokOr) {
+      left = interpret_expression(expression->LogicalOp.left, state, arena,
+                                  scratch, hashmap_arena);
+      if (expression->LogicalOp.op.token_type == TokOr && is_truthy(&left))
+        return (InterpretResult){.type = BOOLEAN, .Bool.value = true};
+      if (expression->LogicalOp.op.token_type == TokAnd && !is_truthy(&left))
+        return (InterpretResult){.type = BOOLEAN, .Bool.value = false};
+      return interpret_expression(expression->LogicalOp.right, state, arena,
+                                  scratch, hashmap_arena);
+    }
+    // fall through
+  case (BINARY_OP):
+    left = interpret_expression(expression->BinaryOp.left, state, arena,
+                                scratch, hashmap_arena);
+    right = interpret_expression(expression->BinaryOp.right, state, arena,
+                                 scratch, hashmap_arena);
+    quicken(expression, &left, &right);
+    return binary_op(expression->BinaryOp.op.token_type, left, right,
+                     scratch);
+  case (BINARY_INT):
+    left = interpret_expression(expression->BinaryOp.left, state, arena,
+                                scratch, hashmap_arena);
+    right = interpret_expression(expression->BinaryOp.right, state, arena,
+                                 scratch, hashmap_arena);
+    if (left.type != INT || right.type != INT)
+      return deoptimize(expression, left, right, scratch);
+    switch (expression->BinaryOp.op.token_type) {
+    case TokPlus:
+      left.Int.value = WRAP(left.Int.value, +, right.Int.value);
+      return left;
+    case TokMinus:
+      left.Int.value = WRAP(left.Int.value, -, right.Int.value);
+      return left;
+    case TokStar:
+      left.Int.value = WRAP(left.Int.value, *, right.Int.value);
+      return left;
+    case TokMod:
+      left.Int.value = integer_mod(left.Int.value, right.Int.value);
+      return left;
+    case TokLt:
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = left.Int.value < right.Int.value};
+    case TokGt:
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = left.Int.value > right.Int.value};
+    case TokLe:
+      return (InterpretResult){
+          .type = BOOLEAN, .Bool.value = left.Int.value <= right.Int.value};
+    case TokGe:
+      return (InterpretResult){
+          .type = BOOLEAN, .Bool.value = left.Int.value >= right.Int.value};
+    case TokEq:
+      return (InterpretResult){
+          .type = BOOLEAN, .Bool.value = left.Int.value == right.Int.value};
+    case TokNe:
+      return (InterpretResult){
+          .type = BOOLEAN, .Bool.value = left.Int.value != right.Int.value};
+    default:
+      return binary_op(expression->BinaryOp.op.token_type, left, right,
+                       scratch);
+    }
+  case (BINARY_NUMBER):
+    left = interpret_expression(expression->BinaryOp.left, state, arena,
+                                scratch, hashmap_arena);
+    right = interpret_expression(expression->BinaryOp.right, state, arena,
+                                 scratch, hashmap_arena);
+    if (left.type != NUMBER || right.type != NUMBER)
+      return deoptimize(expression, left, right, scratch);
+    switch (expression->BinaryOp.op.token_type) {
+    case TokPlus:
+      left.Number.value += right.Number.value;
+      return left;
+    case TokMinus:
+      left.Number.value -= right.Number.value;
+      return left;
+    case TokStar:
+      left.Number.value *= right.Number.value;
+      return left;
+    case TokSlash:
+      left.Number.value /= right.Number.value;
+      return left;
+    case TokLt:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value < right.Number.value};
+    case TokGt:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value > right.Number.value};
+    case TokLe:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value <= right.Number.value};
+    case TokGe:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value >= right.Number.value};
+    case TokEq:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value == right.Number.value};
+    case TokNe:
+      return (InterpretResult){
+          .type = BOOLEAN,
+          .Bool.value = left.Number.value != right.Number.value};
+    default:
+      return binary_op(expression->BinaryOp.op.token_type, left, right,
+                       scratch);
+    }
+  case (BINARY_STRING):
+    left = interpret_expression(expression->BinaryOp.left, state, arena,
+                                scratch, hashmap_arena);
+    right = interpret_expression(expression->BinaryOp.right, state, arena,
+                                 scratch, hashmap_arena);
+    if (left.type != STR || right.type != STR)
+      return deoptimize(expression, left, right, scratch);
+    switch (expression->BinaryOp.op.token_type) {
+    case TokPlus:
+      return string_append(left, right.String.value, right.len, scratch);
+    case TokEq:
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = string_equal(&left, &right)};
+    case TokNe:
+      return (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = !string_equal(&left, &right)};
+    default:
+      return binary_op(expression->BinaryOp.op.token_type, left, right,
+                       scratch);
+    }
 
-    case (UNARY_OP):
-      right = interpret((Node){.type = EXPR, .expr = expression->UnaryOp.exp},
-                        state, arena, hashmap_arena);
-      switch (right.type) {
-      case (NUMBER):
-        if (expression->UnaryOp.op.token_type == TokMinus) {
-          return (InterpretResult){.type = NUMBER,
-                                   .Number.value = -right.Number.value};
-          if (expression->UnaryOp.op.token_type == TokPlus) {
-            return (InterpretResult){.type = NUMBER,
-                                     .Number.value = +right.Number.value};
-          }
-          assert("Shouldn't reach here");
-        }
-      case (BOOLEAN):
-        if (expression->UnaryOp.op.token_type == TokNot) {
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = !right.Bool.value};
-        }
-      default:
-        assert("shouldn't reach here");
-      }
-    case (LOGICAL_OP):
-      left = interpret((Node){.type = EXPR, .expr = expression->LogicalOp.left},
-                       state, arena, hashmap_arena);
-      if (left.type == BOOLEAN) {
-        if (expression->BinaryOp.op.token_type == TokOr &&
-            left.Bool.value == true)
-          return (InterpretResult){.type = BOOLEAN, .Bool.value = true};
-        if (expression->BinaryOp.op.token_type == TokAnd &&
-            left.Bool.value == false)
-          return (InterpretResult){.type = BOOLEAN, .Bool.value = false};
-        return interpret(
-            (Node){.type = EXPR, .expr = expression->LogicalOp.right}, state,
-            arena, hashmap_arena);
-      }
-      assert("Shouldn't reach here");
-    case (BINARY_OP):
-      left = interpret((Node){.type = EXPR, .expr = expression->BinaryOp.left},
-                       state, arena, hashmap_arena);
-      right =
-          interpret((Node){.type = EXPR, .expr = expression->BinaryOp.right},
-                    state, arena, hashmap_arena);
-      if ((left.type == NUMBER || left.type == BOOLEAN) &&
-          (right.type == NUMBER || right.type == BOOLEAN)) {
-        float left_value = left.type == NUMBER ? left.Number.value
-                           : left.Bool.value   ? 1
-                                               : 0;
-        float right_value = right.type == NUMBER ? right.Number.value
-                            : right.Bool.value   ? 1
-                                                 : 0;
-        switch (expression->BinaryOp.op.token_type) {
-        case (TokPlus):
-          return (InterpretResult){.type = NUMBER,
-                                   .Number.value = left_value + right_value};
-        case (TokMinus):
-          return (InterpretResult){.type = NUMBER,
-                                   .Number.value = left_value - right_value};
-        case (TokStar):
-          return (InterpretResult){.type = NUMBER,
-                                   .Number.value = left_value * right_value};
-        case (TokSlash):
-          return (InterpretResult){.type = NUMBER,
-                                   .Number.value = left_value / right_value};
-        case (TokMod):
-          return (InterpretResult){
-              .type = NUMBER,
-              .Number.value = ((int)((int)left_value % (int)right_value) +
-                               (int)right_value) %
-                              (int)right_value};
-        case (TokCaret):
-          return (InterpretResult){
-              .type = NUMBER, .Number.value = pow(left_value, right_value)};
-        case (TokEq):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value == right_value};
-        case (TokLe):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value <= right_value};
-        case (TokGe):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value >= right_value};
-        case (TokLt):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value < right_value};
-        case (TokGt):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value > right_value};
-        case (TokNe):
-          return (InterpretResult){.type = BOOLEAN,
-                                   .Bool.value = left_value != right_value};
-        default:
-          assert("Shouldn't reach here");
-        }
-      }
-      if (left.type == STR && right.type == STR) {
-        if (expression->BinaryOp.op.token_type == TokPlus) {
-          char *result =
-              arena_alloc(arena, left.String.len + right.String.len + 1);
-          for (int i = 0; i < left.String.len; i++) {
-            result[i] = left.String.value[i];
-          }
-          for (int i = left.String.len; i < left.String.len + right.String.len;
-               i++) {
-            result[i] = right.String.value[i - left.String.len];
-          }
-          return (InterpretResult){.type = STR,
-                                   .String.value = result,
-                                   strlen(result),
-                                   .String.alloced = true};
-        }
-        if (expression->BinaryOp.op.token_type == TokEq) {
-          return (InterpretResult){
-              .type = BOOLEAN,
-              .Bool.value = strcmp(left.String.value, right.String.value) == 0};
-        }
-        if (expression->BinaryOp.op.token_type == TokNe) {
-          return (InterpretResult){
-              .type = BOOLEAN,
-              .Bool.value = strcmp(left.String.value, right.String.value) != 0};
-        }
-        assert("Shouldn't reach here");
-      }
-      if (left.type == STR && right.type == NUMBER) {
-        if (expression->BinaryOp.op.token_type == TokPlus) {
-          char *result;
-          if (right.Number.value == (int)right.Number.value) {
-            result = arena_alloc(
-                arena, left.String.len +
-                           snprintf(NULL, 0, "%d", (int)right.Number.value) +
-                           1);
-            sprintf(result, "%.*s%d", left.String.len, left.String.value,
-                    (int)right.Number.value);
+  default:
+    assert("Shouldn't reach here");
+  }
+  return (InterpretResult){.type = NONE};
+}
 
-          } else {
-            result = arena_alloc(
-                arena, left.String.len +
-                           snprintf(NULL, 0, "%f", right.Number.value) + 1);
-            sprintf(result, "%.*s%f", left.String.len, left.String.value,
-                    right.Number.value);
-          }
-          return (InterpretResult){.type = STR,
-                                   .String.value = result,
-                                   .String.alloced = true,
-                                   .String.len = strlen(result)};
-        }
-        if (expression->BinaryOp.op.token_type == TokStar) {
-          char *result =
-              arena_alloc(arena, left.String.len * (int)right.Number.value + 1);
-          for (int i = 0; i < right.Number.value; i++) {
-            strncat(result, left.String.value, left.String.len);
-          }
-          return (InterpretResult){.type = STR,
-                                   .String.value = result,
-                                   .String.len = strlen(result),
-                                   .String.alloced = true};
-        }
-        assert("Shouldn't reach here");
-      }
+// Statements return true once a `ret` ran, with its value stored in `ret`.
+// Temporaries of a statement are released when it ends, except for the
+// returned value, which the caller's statement releases.
+bool interpret_statements(Statements *stmts, State *state, Arena *arena,
+                          Arena *scratch, Arena *hashmap_arena,
+                          InterpretResult *ret) {
+  Statement *current_stmt = stmts->head;
+  while (current_stmt != NULL) {
+    size_t mark = scratch->pointer;
+    if (profile.enabled)
+      profile_statement_enter(current_stmt);
+    bool returned = interpret_statement(current_stmt, state, arena, scratch,
+                                        hashmap_arena, ret);
+    if (profile.enabled)
+      profile_statement_exit();
+    if (returned)
+      return true;
+    scratch_release(scratch, mark);
+    current_stmt = current_stmt->next;
+  };
+  return false;
+}
 
-    default:
-      assert("Shouldn't reach here");
+bool interpret_statement(Statement *statement, State *state, Arena *arena,
+                         Arena *scratch, Arena *hashmap_arena,
+                         InterpretResult *ret) {
+  InterpretResult res;
+  COUNT(evaluated_nodes);
+  COUNT(evaluated_statements[statement->type]);
+  switch (statement->type) {
+  case FUNCTION_DECLARATION:
+    state_func_set(state, statement->FunctionDeclaration.slot, statement);
+    return false;
+  case PARAMETER:
+    return false;
+  case STATEMENT_FUNCTION_CALL:
+    interpret_expression(statement->FunctionCall.expr, state, arena, scratch,
+                         hashmap_arena);
+    return false;
+  case LOCAL_ASSIGNMENT:;
+    InterpretResult rres =
+        interpret_expression(&statement->LocalAssignment.right, state, arena,
+                             scratch, hashmap_arena);
+    if (statement->LocalAssignment.left.type == IDENTIFIER) {
+      state_set(state, 0, statement->LocalAssignment.left.Identifier.slot,
+                rres);
+      return false;
     }
-  case STMTS:;
-    Statement *current_stmt = node.stmts->head;
-    while (current_stmt != NULL) {
-      InterpretResult tmp =
-          interpret((Node){.type = STMT, .stmt = current_stmt}, state, arena,
-                    hashmap_arena);
-      if (tmp.type == RETURN)
-        return tmp;
-      current_stmt = current_stmt->next;
-    };
-    return (InterpretResult){.type = NONE};
-  case STMT:;
-    Statement *statement = node.stmt;
-    InterpretResult res;
-    switch (statement->type) {
-    case FUNCTION_DECLARATION:
-      state_func_set(state, statement->FunctionDeclaration.name,
-                     statement->FunctionDeclaration.name_len, statement);
-      return (InterpretResult){.type = NONE};
-    case PARAMETER:
-      return (InterpretResult){.type = NONE};
-    case STATEMENT_FUNCTION_CALL:
-      return interpret(
-          (Node){.type = EXPR, .expr = statement->FunctionCall.expr}, state,
-          arena, hashmap_arena);
-    case LOCAL_ASSIGNMENT:;
-      InterpretResult rres = interpret(
-          (Node){.type = EXPR, .expr = &(statement->LocalAssignment.right)},
-          state, arena, hashmap_arena);
-      if (statement->LocalAssignment.left.type == IDENTIFIER) {
-        state_set_local(state, statement->LocalAssignment.left.Identifier.name,
-                        statement->Assignment.left->Identifier.len, rres);
-        return (InterpretResult){.type = NONE};
-      }
-      assert(false);
+    assert(false);
 
-    case RET:;
-      InterpretResult *new_res = arena_alloc(arena, sizeof(InterpretResult));
-      *new_res =
-          interpret((Node){.type = EXPR, .expr = &(statement->Return.val)},
-                    state, arena, hashmap_arena);
-      return (InterpretResult){.type = RETURN, .Return = {new_res}};
-    case PRINT:
-      res = interpret(
-          (Node){.type = EXPR, .expr = statement->PrintStatement.value}, state,
-          arena, hashmap_arena);
-      interpret_result_print(&res, "");
-      break;
-    case PRINTLN:
-      res = interpret(
-          (Node){.type = EXPR, .expr = statement->PrintlnStatement.value},
-          state, arena, hashmap_arena);
-      interpret_result_print(&res, "\n");
-      break;
-    case WHILE:;
-      State new_state = get_new_state(state, hashmap_arena);
-      while (1) {
-        InterpretResult test_res =
-            interpret((Node){.type = EXPR, .expr = statement->While.test},
-                      &new_state, arena, hashmap_arena);
-        bool stop = false;
-        switch (test_res.type) {
-        case BOOLEAN:
-          if (!test_res.Bool.value)
-            stop = true;
-          break;
-        case STR:
-          if (test_res.String.len == 0)
-            stop = true;
-          break;
-        case NUMBER:
-          if (test_res.Number.value == 0.0)
-            stop = true;
-          break;
-        case NONE:
-        case RETURN:
-          assert("shouldn't be here");
-        }
-        if (stop)
-          break;
-        InterpretResult while_res =
-            interpret((Node){.type = STMTS, .stmts = statement->While.stmts},
-                      &new_state, arena, hashmap_arena);
-        if (while_res.type == RETURN) {
-          free_state(&new_state, hashmap_arena);
-          return while_res;
-        }
-      }
-      free_state(&new_state, hashmap_arena);
-      break;
-    case FOR:;
-      State for_state = get_new_state(state, hashmap_arena);
-      Expression *identifier = statement->For.identifier;
-      InterpretResult start =
-          interpret((Node){.type = EXPR, .expr = statement->For.start},
-                    &for_state, arena, hashmap_arena);
-      state_set(&for_state, identifier->Identifier.name,
-                identifier->Identifier.len, start);
-      InterpretResult stop =
-          interpret((Node){.type = EXPR, .expr = statement->For.stop},
-                    &for_state, arena, hashmap_arena);
-      InterpretResult step =
-          interpret((Node){.type = EXPR, .expr = statement->For.step},
-                    &for_state, arena, hashmap_arena);
-      while (1) {
-        InterpretResult current_val =
-            state_get(&for_state, identifier->Identifier.name,
-                      identifier->Identifier.len);
-        if (((start.Number.value <= stop.Number.value) &&
-             (current_val.Number.value >= stop.Number.value)) ||
-            ((start.Number.value >= stop.Number.value) &&
-             (current_val.Number.value <= stop.Number.value))) {
-          break;
-        }
-        InterpretResult for_res =
-            interpret((Node){.type = STMTS, .stmts = statement->For.stmts},
-                      &for_state, arena, hashmap_arena);
-        if (for_res.type == RETURN) {
-          free_state(&for_state, hashmap_arena);
-          return for_res;
-        }
-        current_val.Number.value += step.Number.value;
-        state_set(&for_state, identifier->Identifier.name,
-                  identifier->Identifier.len, current_val);
-      }
-      free_state(&for_state, hashmap_arena);
-      break;
-    case IF:
-      res = interpret((Node){.type = EXPR, .expr = statement->IfStatement.test},
-                      state, arena, hashmap_arena);
-      State child_state = get_new_state(state, hashmap_arena);
-      InterpretResult result;
-      switch (res.type) {
-      case NUMBER:
-        if (res.Number.value == 0.0)
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.then_stmts},
-              &child_state, arena, hashmap_arena);
-        else
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.else_stmts},
-              &child_state, arena, hashmap_arena);
-        break;
-      case BOOLEAN:
-        if (res.Bool.value == true)
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.then_stmts},
-              &child_state, arena, hashmap_arena);
-        else
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.else_stmts},
-              &child_state, arena, hashmap_arena);
-        break;
-      case STR:
-        if (res.String.len != 0)
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.then_stmts},
-              &child_state, arena, hashmap_arena);
-        else
-          result = interpret(
-              (Node){.type = STMTS, .stmts = statement->IfStatement.else_stmts},
-              &child_state, arena, hashmap_arena);
+  case RET:;
+    *ret = interpret_expression(&statement->Return.val, state, arena, scratch,
+                                hashmap_arena);
+    *ret = buffer_detach(*ret, scratch);
+    return true;
+  case PRINT:
+    res = interpret_expression(statement->PrintStatement.value, state, arena,
+                               scratch, hashmap_arena);
+    interpret_result_print(&res, "");
+    break;
+  case PRINTLN:
+    res = interpret_expression(statement->PrintlnStatement.value, state, arena,
+                               scratch, hashmap_arena);
+    interpret_result_print(&res, "\n");
+    break;
+  case WHILE:;
+    State while_scope;
+    State *while_state = state_enter(state, &while_scope,
+                                     statement->While.stmts, hashmap_arena);
+    size_t mark = scratch->pointer;
+    while (1) {
+      InterpretResult test_res =
+          interpret_expression(statement->While.test, while_state, arena,
+                               scratch, hashmap_arena);
+      if (!is_truthy(&test_res))
         break;
-      case RETURN:
-      case NONE:
-        assert(false);
+      if (interpret_statements(statement->While.stmts, while_state, arena,
+                               scratch, hashmap_arena, ret)) {
+        state_exit(state, while_state, hashmap_arena);
+        return true;
       }
-      free_state(&child_state, hashmap_arena);
-      return result;
-      break;
-    case ASSIGNMENT:;
-      rres =
-          interpret((Node){.type = EXPR, .expr = statement->Assignment.right},
-                    state, arena, hashmap_arena);
-      if (statement->Assignment.left->type == IDENTIFIER) {
-        state_set(state, statement->Assignment.left->Identifier.name,
-                  statement->Assignment.left->Identifier.len, rres);
-        return (InterpretResult){.type = NONE};
+      scratch_release(scratch, mark);
+    }
+    state_exit(state, while_state, hashmap_arena);
+    break;
+  case FOR:;
+    State for_scope;
+    State *for_state = state_enter(state, &for_scope, statement->For.stmts,
+                                   hashmap_arena);
+    Expression *identifier = statement->For.identifier;
+    InterpretResult start = interpret_expression(
+        statement->For.start, for_state, arena, scratch, hashmap_arena);
+    state_set(for_state, identifier->Identifier.depth,
+              identifier->Identifier.slot, start);
+    InterpretResult stop = interpret_expression(
+        statement->For.stop, for_state, arena, scratch, hashmap_arena);
+    InterpretResult step = interpret_expression(
+        statement->For.step, for_state, arena, scratch, hashmap_arena);
+    while (1) {
+      InterpretResult current_val =
+          state_get(for_state, identifier->Identifier.depth,
+                    identifier->Identifier.slot);
+      if (for_done(&start, &stop, &current_val))
+        break;
+      if (interpret_statements(statement->For.stmts, for_state, arena,
+                               scratch, hashmap_arena, ret)) {
+        state_exit(state, for_state, hashmap_arena);
+        return true;
       }
-      assert("Tried to assign not to Identifier");
+      for_step(&current_val, &step);
+      state_set(for_state, identifier->Identifier.depth,
+                identifier->Identifier.slot, current_val);
     }
-    assert("Should know the type of Node");
+    state_exit(state, for_state, hashmap_arena);
     break;
+  case IF:
+    res = interpret_expression(statement->IfStatement.test, state, arena,
+                               scratch, hashmap_arena);
+    assert(res.type != NONE);
+    Statements *branch = is_truthy(&res) ? statement->IfStatement.then_stmts
+                                         : statement->IfStatement.else_stmts;
+    State branch_scope;
+    State *branch_state =
+        state_enter(state, &branch_scope, branch, hashmap_arena);
+    bool returned = interpret_statements(branch, branch_state, arena, scratch,
+                                         hashmap_arena, ret);
+    state_exit(state, branch_state, hashmap_arena);
+    return returned;
+  case ASSIGNMENT:;
+    rres = interpret_expression(statement->Assignment.right, state, arena,
+                                scratch, hashmap_arena);
+    if (statement->Assignment.left->type == IDENTIFIER) {
+      state_set(state, statement->Assignment.left->Identifier.depth,
+                statement->Assignment.left->Identifier.slot, rres);
+      return false;
+    }
+    assert("Tried to assign not to Identifier");
   }
-  assert("Shouldn't leave switch");
-  return (InterpretResult){.type = NONE};
+  return false;
 }
 
 void interpret_result_print(InterpretResult *result, char *newline) {
+  char number[NUMBER_MAX];
   switch (result->type) {
-  case RETURN:
+  case (INT):
   case (NUMBER):
-    if (result->Number.value == (int)result->Number.value)
-      printf("%d%s", (int)result->Number.value, newline);
-    else
-      printf("%f%s", result->Number.value, newline);
+    output_write(number, number_format(result, number));
     break;
   case (BOOLEAN):
-    printf("%s%s", result->Bool.value ? "true" : "false", newline);
+    if (result->Bool.value)
+      output_write("true", 4);
+    else
+      output_write("false", 5);
     break;
   case (STR):
-    printf("%.*s%s", result->String.len, result->String.value, newline);
+    output_write(result->String.value, result->len);
     break;
   case (NONE):
-    break;
+    return;
   }
+  output_write(newline, strlen(newline));
 }
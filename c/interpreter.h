@@ -6,7 +6,48 @@
 #include <stdbool.h>
 #include <string.h>
 
+// Integer arithmetic wraps around instead of overflowing.
+#define WRAP(left, operator, right)                                            \
+  ((long)((unsigned long)(left) operator(unsigned long)(right)))
+
+#define IS_NUMERIC(result) ((result).type == INT || (result).type == NUMBER)
+#define AS_DOUBLE(result)                                                      \
+  ((result).type == INT ? (double)(result).Int.value : (result).Number.value)
+
 InterpretResult interpret_ast(Node node, Arena *arena);
+InterpretResult escape_value(InterpretResult value, Arena *scratch,
+                             Arena *arena);
+void scratch_release(Arena *scratch, size_t mark);
 InterpretResult interpret(Node node, State *state, Arena *arena,
-                          Arena *hashmap_arena);
+                          Arena *scratch, Arena *hashmap_arena);
+InterpretResult interpret_expression(Expression *expression, State *state,
+                                     Arena *arena, Arena *scratch,
+                                     Arena *hashmap_arena);
+bool interpret_statements(Statements *stmts, State *state, Arena *arena,
+                          Arena *scratch, Arena *hashmap_arena,
+                          InterpretResult *ret);
+bool interpret_statement(Statement *statement, State *state, Arena *arena,
+                         Arena *scratch, Arena *hashmap_arena,
+                         InterpretResult *ret);
+void quicken(Expression *expression, InterpretResult *left,
+             InterpretResult *right);
+InterpretResult deoptimize(Expression *expression, InterpretResult left,
+                           InterpretResult right, Arena *scratch);
+bool string_equal(InterpretResult *left, InterpretResult *right);
+InterpretResult string_append(InterpretResult left, char *right,
+                              unsigned int len, Arena *arena);
+bool repeat_count_valid(InterpretResult *left, double count);
+InterpretResult string_repeat(InterpretResult left, double count,
+                              Arena *arena);
+bool is_integer(InterpretResult *value);
+long integer_value(InterpretResult *value);
+double number_value(InterpretResult *value);
+long integer_mod(long left, long right);
+double number_mod(double left, double right);
+InterpretResult integer_pow(long base, long exponent);
+InterpretResult integer_op(TokenType op, long left, long right);
+InterpretResult number_op(TokenType op, double left, double right);
+int number_format(InterpretResult *value, char *buffer);
+InterpretResult binary_op(TokenType op, InterpretResult left,
+                          InterpretResult right, Arena *arena);
 void interpret_result_print(InterpretResult *result, char *newline);
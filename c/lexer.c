@@ -1,9 +1,13 @@
 #include "lexer.h"
 #include "memory.h"
+#include "scan.h"
+#include "symbols.h"
 #include "tokens.h"
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 
 char advance(Lexer *lexer) {
@@ -11,15 +15,23 @@ char advance(Lexer *lexer) {
     return '\0';
   char ch = lexer->source[lexer->curr];
   lexer->curr++;
-  lexer->line_position++;
   return ch;
 }
 
 void add_token(Lexer *lexer, TokenType token_type) {
-  Token *token = arena_alloc(lexer->arena, sizeof(Token));
-  *token = token_init(token_type, &lexer->source[lexer->start], lexer->line,
-                      lexer->curr - lexer->start, lexer->line_position);
-  lexer->tokens_len++;
+  if (lexer->curr - lexer->start > TOKEN_LEN_MAX)
+    lexer_error(lexer, "Token too long", lexer->start);
+  GROW(lexer->tokens, lexer->tokens_len, lexer->tokens_cap);
+  lexer->tokens[lexer->tokens_len++] =
+      (Token){lexer->start, lexer->curr - lexer->start, token_type};
+}
+
+void lexer_error(Lexer *lexer, char *message, long offset) {
+  LineTable lines = line_table_build(lexer->source, lexer->source_len);
+  unsigned int line, column;
+  line_table_find(&lines, offset, &line, &column);
+  printf("%s at line %u at position %u", message, line, column);
+  exit(EXIT_FAILURE);
 }
 
 char peek(Lexer *lexer) {
@@ -43,12 +55,10 @@ char match_char(Lexer *lexer, char expected) {
 }
 
 void handle_number(Lexer *lexer) {
-  while (isdigit(peek(lexer)))
-    advance(lexer);
+  lexer->curr = scan_digits(lexer->source, lexer->curr, lexer->source_len);
   if ((peek(lexer) == '.') && (isdigit(lookahead(lexer)))) {
-    advance(lexer);
-    while (isdigit(peek(lexer)))
-      advance(lexer);
+    lexer->curr =
+        scan_digits(lexer->source, lexer->curr + 1, lexer->source_len);
     add_token(lexer, TokFloat);
   } else {
     add_token(lexer, TokInteger);
@@ -56,37 +66,46 @@ void handle_number(Lexer *lexer) {
 }
 
 void handle_string(Lexer *lexer, char quote) {
-  while ((lexer->curr < lexer->source_len) &&
-         (lexer->source[lexer->curr] != quote))
-    advance(lexer);
-  if (lexer->curr >= lexer->source_len) {
-    printf("Unterminated string starting at line %d at position %d",
-           lexer->line, lexer->line_position);
-    exit(EXIT_FAILURE);
+  lexer->curr =
+      scan_to(lexer->source, lexer->curr, lexer->source_len, quote);
+  if (lexer->curr >= lexer->source_len && lexer->worker) {
+    lexer->curr = lexer->start;
+    return;
   }
+  if (lexer->curr >= lexer->source_len)
+    lexer_error(lexer, "Unterminated string starting", lexer->start);
   advance(lexer);
   add_token(lexer, TokString);
 }
 
 void handle_identifier(Lexer *lexer) {
-  while ((isalnum(peek(lexer))) || (peek(lexer) == '_'))
-    advance(lexer);
+  lexer->curr =
+      scan_identifier(lexer->source, lexer->curr, lexer->source_len);
   add_token(lexer,
             keywords(&lexer->source[lexer->start], lexer->curr - lexer->start));
 }
 
-void tokenize(Lexer *lexer) {
-  while (lexer->curr < lexer->source_len) {
+void tokenize(Lexer *lexer) { tokenize_range(lexer, lexer->source_len); }
+
+// Lexes tokens starting before `end`. Only a string literal can run past it.
+void tokenize_range(Lexer *lexer, long end) {
+  if (lexer->source_len > INT_MAX) {
+    puts("Scripts are limited to 2 GB");
+    exit(EXIT_FAILURE);
+  }
+  while (lexer->curr < end) {
     lexer->start = lexer->curr;
     char ch = advance(lexer);
     switch (ch) {
+    case ' ':
+    case '\t':
+    case '\r':
     case '\n':
-      lexer->line++;
-      lexer->line_position = 1;
+      lexer->curr = scan_blank(lexer->source, lexer->start, end);
       break;
     case '#':
-      while ((peek(lexer) != '\n') && (lexer->curr < lexer->source_len))
-        advance(lexer);
+      lexer->curr =
+          scan_to(lexer->source, lexer->curr, lexer->source_len, '\n');
       break;
     case '(':
       add_token(lexer, TokLparen);
@@ -117,9 +136,8 @@ void tokenize(Lexer *lexer) {
       break;
     case '-':
       if (match_char(lexer, '-') == 0) {
-        while ((peek(lexer) != '\n') && (lexer->curr < lexer->source_len)) {
-          advance(lexer);
-        }
+        lexer->curr =
+            scan_to(lexer->source, lexer->curr, lexer->source_len, '\n');
       } else {
         add_token(lexer, TokMinus);
       }
@@ -180,10 +198,11 @@ void tokenize(Lexer *lexer) {
       }
       break;
     case '"':
-      handle_string(lexer, ch);
-      break;
     case '\'':
       handle_string(lexer, ch);
+      // A worker stops at a string that isn't terminated.
+      if (lexer->curr == lexer->start)
+        return;
       break;
     default:
       if isdigit (ch) {
@@ -195,3 +214,82 @@ void tokenize(Lexer *lexer) {
     }
   }
 }
+
+void *lex_chunk(void *chunk) {
+  LexChunk *self = chunk;
+  tokenize_range(&self->lexer, self->end);
+  return NULL;
+}
+
+// Token offsets are absolute, so joining a chunk is a copy.
+void join_chunk(Lexer *lexer, Lexer *chunk) {
+  long len = lexer->tokens_len + chunk->tokens_len;
+  if (len > lexer->tokens_cap) {
+    lexer->tokens_cap = len;
+    lexer->tokens = realloc(lexer->tokens, len * sizeof(Token));
+  }
+  memcpy(lexer->tokens + lexer->tokens_len, chunk->tokens,
+         chunk->tokens_len * sizeof(Token));
+  lexer->tokens_len = len;
+  lexer->curr = chunk->curr;
+}
+
+// Chunks end after a newline, so only a string literal can cross into the
+// next one. When it does, the next chunk was lexed from a wrong state and is
+// lexed again from where the string ended. The joined tokens are the ones
+// tokenize() produces.
+void tokenize_parallel(Lexer *lexer, int threads) {
+  long len = lexer->source_len - lexer->curr;
+  if (threads > len / LEX_CHUNK_MIN)
+    threads = len / LEX_CHUNK_MIN;
+  if (threads <= 1) {
+    tokenize(lexer);
+    return;
+  }
+
+  LexChunk *chunks = malloc(threads * sizeof(LexChunk));
+  long begin = lexer->curr;
+  for (int i = 0; i < threads; i++) {
+    long end = lexer->source_len;
+    if (i < threads - 1) {
+      long target = lexer->curr + len * (i + 1) / threads;
+      if (target < begin)
+        target = begin;
+      char *newline =
+          memchr(lexer->source + target, '\n', lexer->source_len - target);
+      if (newline != NULL)
+        end = newline - lexer->source + 1;
+    }
+    LexChunk *chunk = &chunks[i];
+    chunk->begin = begin;
+    chunk->end = end;
+    chunk->lexer = (Lexer){.start = begin,
+                           .curr = begin,
+                           .source = lexer->source,
+                           .source_len = lexer->source_len,
+                           .worker = true};
+    pthread_create(&chunk->thread, NULL, lex_chunk, chunk);
+    begin = end;
+  }
+
+  for (int i = 0; i < threads; i++)
+    pthread_join(chunks[i].thread, NULL);
+
+  for (int i = 0; i < threads; i++) {
+    LexChunk *chunk = &chunks[i];
+    if (lexer->curr < chunk->end) {
+      // Chunks that started inside a string, or hit one that never ends,
+      // are lexed again on this thread, which reports the error.
+      if (chunk->begin != lexer->curr || chunk->lexer.curr < chunk->end) {
+        chunk->lexer.tokens_len = 0;
+        chunk->lexer.start = lexer->curr;
+        chunk->lexer.curr = lexer->curr;
+        chunk->lexer.worker = false;
+        tokenize_range(&chunk->lexer, chunk->end);
+      }
+      join_chunk(lexer, &chunk->lexer);
+    }
+    free(chunk->lexer.tokens);
+  }
+  free(chunks);
+}
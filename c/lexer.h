@@ -1,22 +1,49 @@
 #pragma once
 #include "memory.h"
 #include "tokens.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+// Sources are split into chunks of at least this many bytes for parallel
+// lexing.
+#define LEX_CHUNK_MIN (64 * 1024)
 
 typedef struct {
   long tokens_len;
   int start;
   int curr;
-  int line;
-  int line_position;
   char *source;
   long source_len;
-  Arena *arena;
+  Token *tokens;
+  long tokens_cap;
+  // Lexes one chunk of a parallel run: an unterminated string only stops the
+  // chunk.
+  bool worker;
 } Lexer;
 
+// A newline-aligned part of the source, lexed on its own thread into its own
+// token buffer on the guess that it doesn't start inside a string literal.
+typedef struct {
+  Lexer lexer;
+  long begin;
+  long end;
+  pthread_t thread;
+} LexChunk;
+
 Lexer lexer_init(char *source, long source_len);
 
 void tokenize(Lexer *lexers);
 
+void tokenize_range(Lexer *lexer, long end);
+
+void tokenize_parallel(Lexer *lexer, int threads);
+
+void *lex_chunk(void *chunk);
+
+void join_chunk(Lexer *lexer, Lexer *chunk);
+
+void lexer_error(Lexer *lexer, char *message, long offset);
+
 char advance(Lexer *lexer);
 
 void add_token(Lexer *lexer, TokenType token_type);
@@ -1,44 +1,100 @@
+#include "compiler.h"
+#include "flat.h"
 #include "interpreter.h"
 #include "lexer.h"
 #include "memory.h"
 #include "model.h"
+#include "optimizer.h"
+#include "output.h"
 #include "parser.h"
+#include "profile.h"
+#include "resolver.h"
+#include "source.h"
+#include "stats.h"
+#include "symbols.h"
+#include "vm.h"
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
-#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 int main(int argc, char *argv[]) {
-  setbuf(stdout, NULL);
-  if (argc < 2) {
-    puts("No input file");
-    exit(EXIT_FAILURE);
+  output_init();
+  bool tree_walk = false;
+  bool flat = false;
+  bool print_stats = false;
+  bool print_profile = false;
+  int lex_threads = 1;
+  char *filename = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tree-walk") == 0)
+      tree_walk = true;
+    else if (strcmp(argv[i], "--flat") == 0)
+      flat = true;
+    else if (strcmp(argv[i], "--stats") == 0)
+      print_stats = true;
+    else if (strcmp(argv[i], "--profile") == 0)
+      print_profile = true;
+    else if (strcmp(argv[i], "--lex-threads") == 0 && i + 1 < argc)
+      lex_threads = atoi(argv[++i]);
+    else
+      filename = argv[i];
   }
-  char *filename = argv[1];
-  FILE *file = fopen(filename, "r");
-  struct stat st;
-
-  if (fstat(fileno(file), &st) != 0) {
-    puts("Failed to get file stat");
-    exit(EXIT_FAILURE);
+  if (filename == NULL) {
+    if (isatty(STDIN_FILENO)) {
+      puts("No input file");
+      exit(EXIT_FAILURE);
+    }
+    filename = "-";
   }
-
-  long file_size = st.st_size;
-  char *contents = malloc(file_size);
-  fread(contents, 1, file_size, file);
-  fclose(file);
+  Source source = source_open(filename);
 
   Arena arena = new_arena();
-  Lexer lexer = (Lexer){0, 0, 0, 1, 1, contents, file_size, &arena};
-  tokenize(&lexer);
+  Lexer lexer = (Lexer){0, 0, 0, source.text, source.len};
+  tokenize_parallel(&lexer, lex_threads);
+  stats.tokens = lexer.tokens_len;
 
-  Parser parser = (Parser){0, lexer.tokens_len, &arena};
+  Parser parser =
+      (Parser){0, lexer.tokens_len, &arena, lexer.tokens, source.text};
   Node new_expr = parse(&parser);
+  free(lexer.tokens);
+  // Everything in the arena so far is the tree.
+  stats.tree_bytes = arena.pointer;
+  stats.optimized_nodes = optimize(new_expr, &arena);
+  resolve(new_expr);
   // node_print(&new_expr);
 
-  InterpretResult result = interpret_ast(new_expr, &arena);
+  InterpretResult result;
+  // Only the tree walker is profiled.
+  if (print_profile) {
+    profile_start(source.text, source.len);
+    result = interpret_ast(new_expr, &arena);
+  } else if (tree_walk) {
+    result = interpret_ast(new_expr, &arena);
+  } else if (flat) {
+    FlatAst ast = flatten(new_expr);
+    stats.flat_bytes = flat_bytes(&ast);
+    result = flat_interpret(&ast, &arena);
+    free_flat(&ast);
+  } else {
+    Chunk chunk = compile(new_expr);
+    // chunk_print(&chunk);
+    result = vm_run(&chunk, &arena);
+    free_chunk(&chunk);
+  }
+  stats.main_arena_bytes = arena.pointer;
   interpret_result_print(&result, "");
+  output_flush();
+  if (print_stats)
+    stats_print();
+  if (print_profile) {
+    profile_print();
+    free_profile();
+  }
 
-  free(contents);
+  free_symbols();
+  source_close(&source);
 }
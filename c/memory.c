@@ -1,10 +1,28 @@
 #include "memory.h"
+#include "output.h"
+#include <stdio.h>
+#include <string.h>
 
-Arena new_arena(void) {
-  return (Arena){mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
-                      MAP_PRIVATE | MAP_ANONYMOUS, 0, 0),
-                 0};
-};
+// Maps `size` bytes of zeroed memory. Pages only take memory once they are
+// touched, so the size is a limit rather than a cost.
+void *reserve(size_t size) {
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (memory == MAP_FAILED) {
+    puts("Failed to reserve memory");
+    exit(EXIT_FAILURE);
+  }
+  return memory;
+}
+
+Arena new_arena(void) { return (Arena){reserve(ARENA_SIZE), 0}; };
+
+// Arenas don't grow, so running out of one ends the program.
+void arena_check(Arena *arena, size_t size) {
+  if (size > ARENA_SIZE || arena->pointer > ARENA_SIZE - size)
+    runtime_error("Out of memory: an arena of %zu bytes is full",
+                  (size_t)ARENA_SIZE);
+}
 
 void *arena_alloc_aligned(Arena *arena, size_t size, size_t align) {
   size_t offset;
@@ -17,6 +35,7 @@ void *arena_alloc_aligned(Arena *arena, size_t size, size_t align) {
     offset = 0;
   }
 
+  arena_check(arena, size);
   void *ptr = &arena->memory[arena->pointer];
   arena->pointer += size;
   return ptr;
@@ -25,3 +44,30 @@ void *arena_alloc_aligned(Arena *arena, size_t size, size_t align) {
 void *arena_alloc(Arena *arena, size_t size) {
   return arena_alloc_aligned(arena, size, 8);
 }
+
+// Grows an allocation. The last allocation of the arena is grown in place,
+// anything else is copied to a new one.
+void *arena_realloc(Arena *arena, void *ptr, size_t size, size_t new_size) {
+  if (arena_contains(arena, ptr) &&
+      (char *)ptr + size == arena->memory + arena->pointer) {
+    if (new_size > size)
+      arena_check(arena, new_size - size);
+    arena->pointer += new_size - size;
+    return ptr;
+  }
+  void *result = arena_alloc(arena, new_size);
+  memcpy(result, ptr, size < new_size ? size : new_size);
+  return result;
+}
+
+bool arena_contains(Arena *arena, void *ptr) {
+  return (char *)ptr >= arena->memory &&
+         (char *)ptr < arena->memory + ARENA_SIZE;
+}
+
+// Frees everything allocated after `mark`. Callers count on new allocations
+// being zeroed, as fresh mmap'ed memory is, so the freed bytes are cleared.
+void arena_reset(Arena *arena, size_t mark) {
+  memset(arena->memory + mark, 0, arena->pointer - mark);
+  arena->pointer = mark;
+}
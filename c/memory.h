@@ -1,10 +1,18 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 
 #define ARENA_SIZE 1024 * 1024 * 1024
+// Grows a malloc'ed array so that one more element fits after `len`.
+#define GROW(array, len, cap)                                                  \
+  if ((len) == (cap)) {                                                        \
+    (cap) = (cap) == 0 ? 64 : (cap) * 2;                                       \
+    (array) = realloc((array), (cap) * sizeof(*(array)));                      \
+  }
+
 typedef struct Arena Arena;
 
 struct Arena {
@@ -12,6 +20,11 @@ struct Arena {
   size_t pointer;
 };
 
+void *reserve(size_t size);
 Arena new_arena(void);
+void arena_check(Arena *arena, size_t size);
 void *arena_alloc_aligned(Arena *arena, size_t size, size_t align);
 void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *ptr, size_t size, size_t new_size);
+bool arena_contains(Arena *arena, void *ptr);
+void arena_reset(Arena *arena, size_t mark);
@@ -1,4 +1,5 @@
 #include "model.h"
+#include "symbols.h"
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -6,7 +7,7 @@
 void expression_print(Expression *expression) {
   switch (expression->type) {
   case (INTEGER):
-    printf("%d ", expression->Integer.value);
+    printf("%ld ", expression->Integer.value);
     break;
   case (FLOAT):
     printf("%.f ", expression->Float.value);
@@ -18,14 +19,15 @@ void expression_print(Expression *expression) {
     printf("%.*s ", expression->String.len, expression->String.value);
     break;
   case (UNARY_OP):
-    printf("(%.*s", expression->UnaryOp.op.lexeme_len,
-           expression->UnaryOp.op.lexeme);
+    printf("(%s", token_type_string(expression->UnaryOp.op.token_type));
     expression_print(expression->UnaryOp.exp);
     printf(")");
     break;
   case (BINARY_OP):
-    printf("(%.*s", expression->BinaryOp.op.lexeme_len,
-           expression->BinaryOp.op.lexeme);
+  case (BINARY_INT):
+  case (BINARY_NUMBER):
+  case (BINARY_STRING):
+    printf("(%s", token_type_string(expression->BinaryOp.op.token_type));
     expression_print(expression->BinaryOp.left);
     expression_print(expression->BinaryOp.right);
     printf(")");
@@ -34,8 +36,7 @@ void expression_print(Expression *expression) {
     expression_print(expression->Grouping.exp);
     break;
   case (LOGICAL_OP):
-    printf("(%.*s", expression->LogicalOp.op.lexeme_len,
-           expression->LogicalOp.op.lexeme);
+    printf("(%s", token_type_string(expression->LogicalOp.op.token_type));
     expression_print(expression->LogicalOp.left);
     expression_print(expression->LogicalOp.right);
     printf(")");
@@ -44,8 +45,8 @@ void expression_print(Expression *expression) {
     printf("%.*s ", expression->Identifier.len, expression->Identifier.name);
     break;
   case (FUNCTION_CALL):
-    printf("%.*s(", expression->FunctionCall.name_len,
-           expression->FunctionCall.name);
+    printf("%.*s(", symbol_get(expression->FunctionCall.symbol)->len,
+           symbol_get(expression->FunctionCall.symbol)->name);
     Expression *curr = expression->FunctionCall.args->head;
     while (curr != NULL) {
       expression_print(curr);
@@ -139,3 +140,63 @@ void node_print(Node *node) {
     break;
   }
 }
+
+char *expression_type_string(enum EXPRESSION_TYPE type) {
+  switch (type) {
+  case INTEGER:
+    return "INTEGER";
+  case FLOAT:
+    return "FLOAT";
+  case BOOL:
+    return "BOOL";
+  case STRING:
+    return "STRING";
+  case UNARY_OP:
+    return "UNARY_OP";
+  case LOGICAL_OP:
+    return "LOGICAL_OP";
+  case BINARY_OP:
+    return "BINARY_OP";
+  case GROUPING:
+    return "GROUPING";
+  case IDENTIFIER:
+    return "IDENTIFIER";
+  case FUNCTION_CALL:
+    return "FUNCTION_CALL";
+  case BINARY_INT:
+    return "BINARY_INT";
+  case BINARY_NUMBER:
+    return "BINARY_NUMBER";
+  case BINARY_STRING:
+    return "BINARY_STRING";
+  }
+  return "UNKNOWN";
+}
+
+char *statement_type_string(enum STATEMENT_TYPE type) {
+  switch (type) {
+  case PRINT:
+    return "PRINT";
+  case PRINTLN:
+    return "PRINTLN";
+  case IF:
+    return "IF";
+  case ASSIGNMENT:
+    return "ASSIGNMENT";
+  case WHILE:
+    return "WHILE";
+  case FOR:
+    return "FOR";
+  case PARAMETER:
+    return "PARAMETER";
+  case STATEMENT_FUNCTION_CALL:
+    return "STATEMENT_FUNCTION_CALL";
+  case FUNCTION_DECLARATION:
+    return "FUNCTION_DECLARATION";
+  case RET:
+    return "RET";
+  case LOCAL_ASSIGNMENT:
+    return "LOCAL_ASSIGNMENT";
+  }
+  return "UNKNOWN";
+}
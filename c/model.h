@@ -6,22 +6,30 @@
 
 typedef struct InterpretResult InterpretResult;
 
+// A value is 16 bytes: a tag word and an 8 byte payload. Strings keep their
+// length and symbol in the tag word; strings built at run time have no
+// symbol, and `owned` is set on those in a variable's StringBuffer (see
+// buffer.h). NONE is zero, so zeroed memory holds NONE values. Numbers are
+// 64-bit integers (INT) or doubles (NUMBER).
 struct InterpretResult {
-  enum RESULT_TYPE { BOOLEAN, RETURN, NUMBER, STR, NONE } type;
-  struct {
-    float value;
-  } Number;
-  struct {
-    char *value;
-    int len;
-    bool alloced;
-  } String;
-  struct {
-    InterpretResult *ret;
-  } Return;
-  struct {
-    bool value;
-  } Bool;
+  enum RESULT_TYPE { NONE, BOOLEAN, INT, NUMBER, STR } type : 7;
+  bool owned : 1;
+  unsigned int symbol : 24;
+  unsigned int len;
+  union {
+    struct {
+      long value;
+    } Int;
+    struct {
+      double value;
+    } Number;
+    struct {
+      char *value;
+    } String;
+    struct {
+      bool value;
+    } Bool;
+  };
 };
 
 enum EXPRESSION_TYPE {
@@ -35,10 +43,40 @@ enum EXPRESSION_TYPE {
   GROUPING,
   IDENTIFIER,
   FUNCTION_CALL,
+  // Binary operators the tree walker specialised while running, see
+  // quicken().
+  BINARY_INT,
+  BINARY_NUMBER,
+  BINARY_STRING,
 };
 
+#define EXPRESSION_TYPES (BINARY_STRING + 1)
+
+// Operand types a binary operator was evaluated with.
+enum FEEDBACK {
+  FEEDBACK_NONE,
+  FEEDBACK_INT,
+  FEEDBACK_NUMBER,
+  FEEDBACK_STRING,
+  FEEDBACK_MIXED,
+};
+
+// Depth of an identifier the resolver couldn't bind to any scope.
+#define UNRESOLVED -1
+
 typedef struct Expression Expression;
 typedef struct Expressions Expressions;
+typedef struct Statement Statement;
+typedef struct CallCache CallCache;
+
+// What a call site found the last time it looked its function up, valid
+// while `func_epoch` (see state.h) still equals `epoch`. The function was
+// defined `depth` scopes above the calling one.
+struct CallCache {
+  Statement *function;
+  unsigned int epoch;
+  unsigned int depth;
+};
 
 struct Expressions {
   Expression *head;
@@ -47,12 +85,18 @@ struct Expressions {
 
 struct Expression {
   enum EXPRESSION_TYPE type;
+  // Type feedback of binary operators: the operand types of the last
+  // evaluations, how many evaluations in a row saw them, and how often a
+  // specialised node had to be turned back.
+  unsigned char seen;
+  unsigned char runs;
+  unsigned char deopts;
   union {
     struct {
-      int value;
+      long value;
     } Integer;
     struct {
-      float value;
+      double value;
     } Float;
     struct {
       bool value;
@@ -60,6 +104,7 @@ struct Expression {
     struct {
       char *value;
       unsigned int len;
+      unsigned int symbol;
     } String;
     struct {
       Token op;
@@ -81,11 +126,14 @@ struct Expression {
     struct {
       char *name;
       unsigned int len;
+      unsigned int symbol;
+      int depth;
+      unsigned int slot;
     } Identifier;
     struct {
-      char *name;
-      unsigned int name_len;
+      unsigned int symbol;
       Expressions *args;
+      CallCache cache;
     } FunctionCall;
   };
   Expression *next;
@@ -105,16 +153,24 @@ enum STATEMENT_TYPE {
   LOCAL_ASSIGNMENT,
 } __attribute__((aligned(8)));
 
-typedef struct Statement Statement;
+#define STATEMENT_TYPES (LOCAL_ASSIGNMENT + 1)
+
 typedef struct Statements Statements;
 
 struct Statements {
   Statement *head;
   int length;
+  // Filled in by the resolver: the number of variables and functions the
+  // block declares, and whether it gets a scope at run time at all.
+  unsigned int scope_size;
+  unsigned int funcs_size;
+  bool has_scope;
 };
 
 struct Statement {
   enum STATEMENT_TYPE type;
+  // Source offset of the statement's first token.
+  unsigned int offset;
   union {
     struct {
       Expression *value;
@@ -145,6 +201,7 @@ struct Statement {
     struct {
       char *name;
       unsigned int name_len;
+      unsigned int symbol;
     } Parameter;
     struct {
       Expression *expr;
@@ -152,8 +209,13 @@ struct Statement {
     struct {
       char *name;
       unsigned int name_len;
+      unsigned int symbol;
       Statements *params;
       Statements *stmts;
+      // Where the body starts: its offset in the VM's code, or its block in
+      // the flat AST.
+      unsigned int entry;
+      unsigned int slot;
     } __attribute__((aligned(8))) FunctionDeclaration;
     struct {
       Expression val;
@@ -190,3 +252,5 @@ void free_statements(Statements *arr);
 void statement_print(Statement *statement);
 void print_statements(Statements *stmts);
 void node_print(Node *node);
+char *expression_type_string(enum EXPRESSION_TYPE type);
+char *statement_type_string(enum STATEMENT_TYPE type);
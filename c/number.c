@@ -0,0 +1,131 @@
+#include "number.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes the digits back to front into a scratch buffer, then copies them.
+int format_unsigned(char *buffer, unsigned long value) {
+  char digits[20];
+  int len = 0;
+  do {
+    digits[sizeof(digits) - ++len] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  memcpy(buffer, digits + sizeof(digits) - len, len);
+  return len;
+}
+
+int format_long(char *buffer, long value) {
+  if (value >= 0)
+    return format_unsigned(buffer, value);
+  buffer[0] = '-';
+  return 1 + format_unsigned(buffer + 1, -(unsigned long)value);
+}
+
+// Fallback for the doubles format_double() has no exact arithmetic for:
+// tries more and more significant digits until the text reads back.
+int format_shortest(char *buffer, double value) {
+  int len = 0;
+  for (int digits = 1; digits <= 17; digits++) {
+    len = snprintf(buffer, NUMBER_MAX, "%.*g", digits, value);
+    if (strtod(buffer, NULL) == value)
+      break;
+  }
+  return len;
+}
+
+const unsigned long powers_of_ten[20] = {1ul,
+                                         10ul,
+                                         100ul,
+                                         1000ul,
+                                         10000ul,
+                                         100000ul,
+                                         1000000ul,
+                                         10000000ul,
+                                         100000000ul,
+                                         1000000000ul,
+                                         10000000000ul,
+                                         100000000000ul,
+                                         1000000000000ul,
+                                         10000000000000ul,
+                                         100000000000000ul,
+                                         1000000000000000ul,
+                                         10000000000000000ul,
+                                         100000000000000000ul,
+                                         1000000000000000000ul,
+                                         10000000000000000000ul};
+
+// A finite double is m / 2^k. Every decimal strictly between the midpoints
+// to its neighbours reads back as it, and so do the midpoints themselves
+// when m is even. Scaled by 10^p for a p that leaves 17 significant digits,
+// the integers between the midpoints are the candidates, and there always
+// is one. Like Ryu, digits are then removed while a multiple of ten is left
+// between the bounds, and of the shortest candidates the one nearest to the
+// value is written. Between 2^-10 and 2^53 the scaled values fit in 64 bits
+// and the exact ones in 128. Ryu covers every double this way, but needs
+// kilobytes of power tables for it; the rest goes to snprintf() here.
+int format_double(char *buffer, double value) {
+  double magnitude = fabs(value);
+  if (magnitude < 0x1p63 && value == (long)value)
+    return format_long(buffer, (long)value);
+#if defined(__SIZEOF_INT128__)
+  if (magnitude >= 0x1p-10 && magnitude < 0x1p53) {
+    // 17 significant digits: the whole digits of large values, the leading
+    // zeros after the point of small ones.
+    int decimals = 17;
+    for (unsigned long whole = magnitude; whole != 0; whole /= 10)
+      decimals--;
+    for (double scaled = magnitude * 10; scaled < 1; scaled *= 10)
+      decimals++;
+
+    int exponent;
+    double fraction = frexp(magnitude, &exponent);
+    unsigned long mantissa = ldexp(fraction, 53);
+    // Scaled by 2^(k + 2), the value is 4m and its neighbours' midpoints
+    // are 2 away, or 1 below a power of two.
+    int shift = 55 - exponent;
+    unsigned __int128 mask = ((unsigned __int128)1 << shift) - 1;
+    unsigned __int128 center = (unsigned __int128)mantissa << 2;
+    unsigned __int128 scale =
+        decimals < 20 ? powers_of_ten[decimals]
+                      : (unsigned __int128)powers_of_ten[19] * 10;
+    unsigned __int128 low =
+        (center - (mantissa == 1ul << 52 ? 1 : 2)) * scale;
+    unsigned __int128 high = (center + 2) * scale;
+    bool inclusive = (mantissa & 1) == 0;
+    unsigned long first = (low >> shift) + ((low & mask) != 0 || !inclusive);
+    unsigned long last = (high >> shift) - ((high & mask) == 0 && !inclusive);
+    // Only if rounding miscounted the leading zeros.
+    if (first > last)
+      return format_shortest(buffer, value);
+    while (decimals > 0 && (first + 9) / 10 <= last / 10) {
+      first = (first + 9) / 10;
+      last /= 10;
+      decimals--;
+    }
+
+    unsigned __int128 exact = center * powers_of_ten[decimals];
+    unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+    unsigned long nearest = exact >> shift;
+    unsigned __int128 rest = exact & mask;
+    if (rest > half || (rest == half && (nearest & 1)))
+      nearest++;
+    nearest = nearest < first ? first : nearest > last ? last : nearest;
+
+    char *at = buffer;
+    if (value < 0)
+      *at++ = '-';
+    at += format_unsigned(at, nearest / powers_of_ten[decimals]);
+    *at++ = '.';
+    unsigned long decimal = nearest % powers_of_ten[decimals];
+    for (int i = decimals - 1; i >= 0; i--) {
+      at[i] = '0' + decimal % 10;
+      decimal /= 10;
+    }
+    return at + decimals - buffer;
+  }
+#endif
+  return format_shortest(buffer, value);
+}
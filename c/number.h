@@ -0,0 +1,14 @@
+#pragma once
+
+// Numbers as text. Integers and whole doubles below 2^63 are written as
+// integers, other doubles as the shortest decimal that reads back as the
+// same double, like Python's repr(): fixed notation from 1e-4 up to 1e16,
+// scientific notation outside it.
+
+// Longest text any of the functions writes, "-2.2250738585072014e-308".
+#define NUMBER_MAX 32
+
+int format_unsigned(char *buffer, unsigned long value);
+int format_long(char *buffer, long value);
+int format_shortest(char *buffer, double value);
+int format_double(char *buffer, double value);
@@ -0,0 +1,254 @@
+#include "optimizer.h"
+#include "interpreter.h"
+#include "memory.h"
+#include "model.h"
+#include "symbols.h"
+#include "tokens.h"
+#include "vm.h"
+#include <stdbool.h>
+
+// Folds operators whose operands are literals and drops groupings. Runs
+// before the resolver, so nodes can be replaced freely. Folding goes through
+// binary_op(), so folded and evaluated expressions can't disagree. Every
+// function returns the number of nodes it removed from the tree.
+
+bool literal_value(Expression *expression, InterpretResult *value) {
+  switch (expression->type) {
+  case INTEGER:
+    *value = (InterpretResult){.type = INT,
+                               .Int.value = expression->Integer.value};
+    return true;
+  case FLOAT:
+    *value = (InterpretResult){.type = NUMBER,
+                               .Number.value = expression->Float.value};
+    return true;
+  case BOOL:
+    *value = (InterpretResult){.type = BOOLEAN,
+                               .Bool.value = expression->Bool.value};
+    return true;
+  case STRING:
+    *value = (InterpretResult){.type = STR,
+                               .symbol = expression->String.symbol,
+                               .len = expression->String.len,
+                               .String.value = expression->String.value};
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Turns `expression` into a literal holding `value`, keeping its place in
+// argument lists. NONE has no literal, so it isn't folded.
+bool set_literal(Expression *expression, InterpretResult value) {
+  Expression *next = expression->next;
+  switch (value.type) {
+  case INT:
+    *expression = (Expression){INTEGER, .Integer = {value.Int.value}};
+    break;
+  case NUMBER:
+    *expression = (Expression){FLOAT, .Float = {value.Number.value}};
+    break;
+  case BOOLEAN:
+    *expression = (Expression){BOOL, .Bool = {value.Bool.value}};
+    break;
+  case STR:
+    *expression = (Expression){
+        STRING, .String = {value.String.value, value.len,
+                           intern(value.String.value, value.len)}};
+    break;
+  case NONE:
+    return false;
+  }
+  expression->next = next;
+  return true;
+}
+
+unsigned int expression_nodes(Expression *expression) {
+  switch (expression->type) {
+  case GROUPING:
+    return 1 + expression_nodes(expression->Grouping.exp);
+  case UNARY_OP:
+    return 1 + expression_nodes(expression->UnaryOp.exp);
+  case LOGICAL_OP:
+    return 1 + expression_nodes(expression->LogicalOp.left) +
+           expression_nodes(expression->LogicalOp.right);
+  case BINARY_OP:
+    return 1 + expression_nodes(expression->BinaryOp.left) +
+           expression_nodes(expression->BinaryOp.right);
+  case FUNCTION_CALL:;
+    unsigned int nodes = 1;
+    Expression *arg = expression->FunctionCall.args->head;
+    for (int i = 0; i < expression->FunctionCall.args->length; i++) {
+      nodes += expression_nodes(arg);
+      arg = arg->next;
+    }
+    return nodes;
+  default:
+    return 1;
+  }
+}
+
+void replace_expression(Expression *expression, Expression *with) {
+  Expression *next = expression->next;
+  *expression = *with;
+  expression->next = next;
+}
+
+unsigned int optimize_expression(Expression *expression, Arena *arena) {
+  unsigned int removed = 0;
+  InterpretResult left, right;
+  switch (expression->type) {
+  case INTEGER:
+  case FLOAT:
+  case BOOL:
+  case STRING:
+  case IDENTIFIER:
+    break;
+  case GROUPING:
+    removed += optimize_expression(expression->Grouping.exp, arena);
+    replace_expression(expression, expression->Grouping.exp);
+    removed++;
+    break;
+  case UNARY_OP:
+    removed += optimize_expression(expression->UnaryOp.exp, arena);
+    if (!literal_value(expression->UnaryOp.exp, &right))
+      break;
+    if (right.type == INT && expression->UnaryOp.op.token_type == TokMinus) {
+      right.Int.value = WRAP(0, -, right.Int.value);
+      removed += set_literal(expression, right);
+    } else if (right.type == NUMBER &&
+               expression->UnaryOp.op.token_type == TokMinus) {
+      right.Number.value = -right.Number.value;
+      removed += set_literal(expression, right);
+    } else if ((right.type == INT || right.type == NUMBER) &&
+               expression->UnaryOp.op.token_type == TokPlus) {
+      removed += set_literal(expression, right);
+    } else if (expression->UnaryOp.op.token_type == TokNot) {
+      right = (InterpretResult){.type = BOOLEAN,
+                                .Bool.value = !is_truthy(&right)};
+      removed += set_literal(expression, right);
+    }
+    break;
+  case LOGICAL_OP:
+    removed += optimize_expression(expression->LogicalOp.left, arena);
+    removed += optimize_expression(expression->LogicalOp.right, arena);
+    TokenType op = expression->LogicalOp.op.token_type;
+    if (op == TokAnd || op == TokOr) {
+      if (!literal_value(expression->LogicalOp.left, &left))
+        break;
+      if (is_truthy(&left) == (op == TokOr)) {
+        removed += 1 + expression_nodes(expression->LogicalOp.right);
+        set_literal(expression, (InterpretResult){.type = BOOLEAN,
+                                                  .Bool.value = op == TokOr});
+      } else {
+        replace_expression(expression, expression->LogicalOp.right);
+        removed += 2;
+      }
+      break;
+    }
+    // Comparisons are logical operators evaluated like binary ones.
+    if (literal_value(expression->LogicalOp.left, &left) &&
+        literal_value(expression->LogicalOp.right, &right) &&
+        set_literal(expression, binary_op(op, left, right, arena)))
+      removed += 2;
+    break;
+  case BINARY_OP:
+  case BINARY_INT:
+  case BINARY_NUMBER:
+  case BINARY_STRING:
+    removed += optimize_expression(expression->BinaryOp.left, arena);
+    removed += optimize_expression(expression->BinaryOp.right, arena);
+    op = expression->BinaryOp.op.token_type;
+    Expression *lhs = expression->BinaryOp.left;
+    Expression *rhs = expression->BinaryOp.right;
+    bool left_literal = literal_value(lhs, &left);
+    bool right_literal = literal_value(rhs, &right);
+    if (left_literal && right_literal) {
+      // Leave modulo by zero to fail at run time, if it runs at all.
+      if (op == TokMod && ((right.type != INT && right.type != NUMBER) ||
+                           number_value(&right) == 0))
+        break;
+      // So are repeats that make too long a string.
+      if (op == TokStar && left.type == STR &&
+          (right.type == INT || right.type == NUMBER) &&
+          !repeat_count_valid(&left, number_value(&right)))
+        break;
+      if (set_literal(expression, binary_op(op, left, right, arena)))
+        removed += 2;
+      break;
+    }
+    // Division is always done on doubles, so integer literals it divides
+    // can be doubles up front and spare the conversion at run time.
+    if (op == TokSlash && right_literal && right.type == INT)
+      set_literal(rhs, (InterpretResult){.type = NUMBER,
+                                         .Number.value = right.Int.value});
+    if (op == TokSlash && left_literal && left.type == INT)
+      set_literal(lhs, (InterpretResult){.type = NUMBER,
+                                         .Number.value = left.Int.value});
+    break;
+  case FUNCTION_CALL:;
+    Expression *arg = expression->FunctionCall.args->head;
+    for (int i = 0; i < expression->FunctionCall.args->length; i++) {
+      removed += optimize_expression(arg, arena);
+      arg = arg->next;
+    }
+    break;
+  }
+  return removed;
+}
+
+unsigned int optimize_statement(Statement *statement, Arena *arena) {
+  switch (statement->type) {
+  case PRINT:
+    return optimize_expression(statement->PrintStatement.value, arena);
+  case PRINTLN:
+    return optimize_expression(statement->PrintlnStatement.value, arena);
+  case IF:
+    return optimize_expression(statement->IfStatement.test, arena) +
+           optimize_statements(statement->IfStatement.then_stmts, arena) +
+           optimize_statements(statement->IfStatement.else_stmts, arena);
+  case ASSIGNMENT:
+    return optimize_expression(statement->Assignment.right, arena);
+  case LOCAL_ASSIGNMENT:
+    return optimize_expression(&statement->LocalAssignment.right, arena);
+  case WHILE:
+    return optimize_expression(statement->While.test, arena) +
+           optimize_statements(statement->While.stmts, arena);
+  case FOR:
+    return optimize_expression(statement->For.start, arena) +
+           optimize_expression(statement->For.stop, arena) +
+           optimize_expression(statement->For.step, arena) +
+           optimize_statements(statement->For.stmts, arena);
+  case STATEMENT_FUNCTION_CALL:
+    return optimize_expression(statement->FunctionCall.expr, arena);
+  case FUNCTION_DECLARATION:
+    return optimize_statements(statement->FunctionDeclaration.stmts, arena);
+  case RET:
+    return optimize_expression(&statement->Return.val, arena);
+  case PARAMETER:
+    break;
+  }
+  return 0;
+}
+
+unsigned int optimize_statements(Statements *stmts, Arena *arena) {
+  unsigned int removed = 0;
+  Statement *current_stmt = stmts->head;
+  while (current_stmt != NULL) {
+    removed += optimize_statement(current_stmt, arena);
+    current_stmt = current_stmt->next;
+  }
+  return removed;
+}
+
+unsigned int optimize(Node node, Arena *arena) {
+  switch (node.type) {
+  case EXPR:
+    return optimize_expression(node.expr, arena);
+  case STMT:
+    return optimize_statement(node.stmt, arena);
+  case STMTS:
+    return optimize_statements(node.stmts, arena);
+  }
+  return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "memory.h"
+#include "model.h"
+
+unsigned int optimize(Node node, Arena *arena);
+unsigned int optimize_expression(Expression *expression, Arena *arena);
+unsigned int optimize_statement(Statement *statement, Arena *arena);
+unsigned int optimize_statements(Statements *stmts, Arena *arena);
+bool literal_value(Expression *expression, InterpretResult *value);
+bool set_literal(Expression *expression, InterpretResult value);
+unsigned int expression_nodes(Expression *expression);
+void replace_expression(Expression *expression, Expression *with);
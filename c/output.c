@@ -0,0 +1,62 @@
+#include "output.h"
+#include "stats.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+Output output;
+
+void output_init(void) {
+  output.len = 0;
+  output.flush_on_newline = isatty(STDOUT_FILENO);
+  atexit(output_flush);
+}
+
+// Runs from atexit() too, before stdio flushes its own streams, so output
+// written by the program comes before an error message printed with puts().
+void output_flush(void) {
+  char *bytes = output.buffer;
+  size_t len = output.len;
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, bytes, len);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0)
+      break;
+    stats.output_writes++;
+    bytes += written;
+    len -= written;
+  }
+  output.len = 0;
+}
+
+void output_write(const char *bytes, size_t len) {
+  if (output.len + len > OUTPUT_BUFFER_SIZE) {
+    output_flush();
+    // Too long to buffer at all; the buffer is empty, so this is in order.
+    while (len > OUTPUT_BUFFER_SIZE) {
+      memcpy(output.buffer, bytes, OUTPUT_BUFFER_SIZE);
+      output.len = OUTPUT_BUFFER_SIZE;
+      output_flush();
+      bytes += OUTPUT_BUFFER_SIZE;
+      len -= OUTPUT_BUFFER_SIZE;
+    }
+  }
+  memcpy(output.buffer + output.len, bytes, len);
+  output.len += len;
+  if (output.flush_on_newline && memchr(bytes, '\n', len) != NULL)
+    output_flush();
+}
+
+void runtime_error(const char *format, ...) {
+  output_flush();
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  putchar('\n');
+  exit(EXIT_FAILURE);
+}
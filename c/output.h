@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Program output is collected in one large buffer and written with as few
+// syscalls as possible: when the buffer is full and at exit, and also after
+// every newline when stdout is a terminal, so interactive output still shows
+// up line by line.
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+typedef struct Output Output;
+
+struct Output {
+  char buffer[OUTPUT_BUFFER_SIZE];
+  size_t len;
+  bool flush_on_newline;
+};
+
+extern Output output;
+
+void output_init(void);
+void output_write(const char *bytes, size_t len);
+void output_flush(void);
+// Reports an error of the running program, after the output it printed so
+// far, and exits.
+void runtime_error(const char *format, ...);
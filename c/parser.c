@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "memory.h"
 #include "model.h"
+#include "stats.h"
 #include "tokens.h"
 #include <assert.h>
 #include <stdio.h>
@@ -12,12 +13,13 @@
 Expression *push_expression(Parser *self, Expression expr) {
   Expression *new_expression = arena_alloc(self->arena, sizeof(Expression));
   *new_expression = expr;
+  COUNT(ast_expressions[expr.type]);
   return new_expression;
 }
 
 Token *advance_parser(Parser *self) {
   if (self->current < self->tokens_list_len) {
-    return ((Token *)self->arena->memory) + self->current++;
+    return self->tokens + self->current++;
   }
   assert("Shouldn't request more then len token");
   return NULL;
@@ -40,10 +42,10 @@ Token *expect(Parser *self, TokenType expected_type) {
 
 Token peek_token(Parser *self) {
   if (self->current < self->tokens_list_len) {
-    return ((Token *)self->arena->memory)[self->current];
+    return self->tokens[self->current];
   }
   assert("Shouldn't request more then len token");
-  return (Token){};
+  return (Token){.token_type = TokEof};
 }
 
 int match_token(Parser *self, TokenType expected_type) {
@@ -52,102 +54,129 @@ int match_token(Parser *self, TokenType expected_type) {
   return token.token_type == expected_type;
 }
 
+char *lexeme(Parser *self, Token *token) {
+  return self->source + token->offset;
+}
+
 Token previous_token(Parser *self) {
   if (self->current > 0)
-    return ((Token *)self->arena->memory)[self->current - 1];
+    return self->tokens[self->current - 1];
   assert("Shouldn't request -1 token");
   return (Token){};
 }
 
-Expression *exponent(Parser *self) {
-  Expression *express = factor(self);
-  while (match_token(self, TokCaret)) {
-    express = push_expression(
-        self, (Expression){BINARY_OP, .BinaryOp = {previous_token(self),
-                                                   express, exponent(self)}});
-  }
-  return express;
-}
+// Binding power of the binary operators, loosest first. Tokens that aren't
+// binary operators have PREC_NONE, which ends every operator loop.
+enum PRECEDENCE {
+  PREC_NONE,
+  PREC_OR,
+  PREC_AND,
+  PREC_EQUALITY,
+  PREC_COMPARE,
+  PREC_SUM,
+  PREC_PRODUCT,
+  PREC_MODULO,
+  PREC_EXPONENT,
+};
 
-Expression *modulo(Parser *self) {
-  Expression *express = exponent(self);
-  while (match_token(self, TokMod)) {
-    express = push_expression(
-        self, (Expression){BINARY_OP, .BinaryOp = {previous_token(self),
-                                                   express, factor(self)}});
-  }
-  return express;
-}
+const unsigned char binary_precedence[TokEof + 1] = {
+    [TokOr] = PREC_OR,         [TokAnd] = PREC_AND,
+    [TokEq] = PREC_EQUALITY,   [TokNe] = PREC_EQUALITY,
+    [TokGt] = PREC_COMPARE,    [TokLt] = PREC_COMPARE,
+    [TokGe] = PREC_COMPARE,    [TokLe] = PREC_COMPARE,
+    [TokPlus] = PREC_SUM,      [TokMinus] = PREC_SUM,
+    [TokStar] = PREC_PRODUCT,  [TokSlash] = PREC_PRODUCT,
+    [TokMod] = PREC_MODULO,    [TokCaret] = PREC_EXPONENT,
+};
 
-Expression *term(Parser *self) {
-  Expression *express = modulo(self);
-  while (match_token(self, TokStar) || match_token(self, TokSlash)) {
-    express = push_expression(
-        self, (Expression){BINARY_OP, .BinaryOp = {previous_token(self),
-                                                   express, modulo(self)}});
-  }
-  return express;
+TokenType peek_type(Parser *self) {
+  if (self->current < self->tokens_list_len)
+    return self->tokens[self->current].token_type;
+  return TokEof;
 }
 
-Expression *expr(Parser *self) {
-  Expression *express = term(self);
-  while (match_token(self, TokPlus) || match_token(self, TokMinus)) {
+// Parses an operand followed by every binary operator that binds at least
+// as tightly as `precedence`. Operators of one level associate to the left,
+// except `^`. Comparisons and `and`/`or` build LOGICAL_OP nodes.
+Expression *binary(Parser *self, int precedence) {
+  Expression *express = unary(self);
+  while (binary_precedence[peek_type(self)] >= precedence) {
+    Token *op = advance_parser(self);
+    int op_precedence = binary_precedence[op->token_type];
+    Expression *right = binary(self, op_precedence == PREC_EXPONENT
+                                         ? op_precedence
+                                         : op_precedence + 1);
     express = push_expression(
-        self, (Expression){BINARY_OP, .BinaryOp = {previous_token(self),
-                                                   express, term(self)}});
+        self, (Expression){op_precedence <= PREC_COMPARE ? LOGICAL_OP
+                                                         : BINARY_OP,
+                           .BinaryOp = {*op, express, right}});
   }
   return express;
 }
 
+Expression *term(Parser *self) { return binary(self, PREC_PRODUCT); }
+
+Expression *expr(Parser *self) { return binary(self, PREC_SUM); }
+
 Expression *primary(Parser *self) {
-  if (match_token(self, TokInteger)) {
-    Token token = previous_token(self);
+  Token *token;
+  switch (peek_type(self)) {
+  case TokInteger: {
+    token = advance_parser(self);
+    char number[token->len + 1];
+    token_copy(token, self->source, number);
     return push_expression(
-        self,
-        (Expression){INTEGER, .Integer = {strtol(token.lexeme, NULL, 10)}});
+        self, (Expression){INTEGER, .Integer = {strtol(number, NULL, 10)}});
   }
-  if (match_token(self, TokFloat)) {
-    Token token = previous_token(self);
+  case TokFloat: {
+    token = advance_parser(self);
+    char number[token->len + 1];
+    token_copy(token, self->source, number);
     return push_expression(
-        self, (Expression){FLOAT, .Float = {strtof(token.lexeme, NULL)}});
+        self, (Expression){FLOAT, .Float = {strtod(number, NULL)}});
   }
-  if (match_token(self, TokTrue)) {
+  case TokTrue:
+    advance_parser(self);
     return push_expression(self, (Expression){BOOL, .Bool = {1}});
-  }
-  if (match_token(self, TokFalse)) {
+  case TokFalse:
+    advance_parser(self);
     return push_expression(self, (Expression){BOOL, .Bool = {0}});
-  }
-  if (match_token(self, TokString)) {
-    Token token = previous_token(self);
-    return push_expression(self, (Expression){STRING, .String = {
-                                                          token.lexeme + 1,
-                                                          token.lexeme_len - 2,
-                                                      }});
-  }
-  if (match_token(self, TokLparen)) {
+  case TokString:
+    token = advance_parser(self);
+    return push_expression(
+        self, (Expression){STRING, .String = {
+                                       lexeme(self, token) + 1,
+                                       token->len - 2,
+                                       token_symbol(token, self->source),
+                                   }});
+  case TokLparen:
+    advance_parser(self);
     Expression *express = logical_or(self);
-    {
-      if (match_token(self, TokRparen)) {
-        return push_expression(self,
-                               (Expression){GROUPING, .Grouping = {express}});
-      }
-    }
+    if (match_token(self, TokRparen))
+      return push_expression(self,
+                             (Expression){GROUPING, .Grouping = {express}});
+    break;
+  default:
+    break;
   }
-  Token *token = expect(self, TokIdentifier);
+  token = expect(self, TokIdentifier);
   if (match_token(self, TokLparen)) {
     Expressions *args = call_params(self);
     expect(self, TokRparen);
-    return push_expression(self, (Expression){.type = FUNCTION_CALL,
-                                              .FunctionCall = {
-                                                  .name = token->lexeme,
-                                                  .name_len = token->lexeme_len,
-                                                  .args = args,
-                                              }});
+    return push_expression(
+        self, (Expression){.type = FUNCTION_CALL,
+                           .FunctionCall = {
+                               .symbol = token_symbol(token, self->source),
+                               .args = args,
+                           }});
   } else {
     return push_expression(
         self, (Expression){.type = IDENTIFIER,
-                           .Identifier = {.name = token->lexeme,
-                                          .len = token->lexeme_len}});
+                           .Identifier = {.name = lexeme(self, token),
+                                          .len = token->len,
+                                          .symbol = token_symbol(
+                                              token, self->source),
+                                          .depth = UNRESOLVED}});
   }
 }
 
@@ -172,58 +201,21 @@ Expressions *call_params(Parser *self) {
 };
 
 Expression *unary(Parser *self) {
-  if (match_token(self, TokNot) || match_token(self, TokMinus) ||
-      match_token(self, TokPlus)) {
+  switch (peek_type(self)) {
+  case TokNot:
+  case TokMinus:
+  case TokPlus:;
+    Token *op = advance_parser(self);
     return push_expression(
-        self,
-        (Expression){UNARY_OP, .UnaryOp = {previous_token(self), unary(self)}});
+        self, (Expression){UNARY_OP, .UnaryOp = {*op, unary(self)}});
+  default:
+    return primary(self);
   }
-  return primary(self);
 }
 
 Expression *factor(Parser *self) { return unary(self); }
 
-Expression *compare(Parser *self) {
-  Expression *express = expr(self);
-  while (match_token(self, TokGt) || match_token(self, TokLt) ||
-         match_token(self, TokGe) || match_token(self, TokLe)) {
-    express = push_expression(
-        self, (Expression){LOGICAL_OP, .LogicalOp = {previous_token(self),
-                                                     express, expr(self)}});
-  }
-  return express;
-}
-
-Expression *equality(Parser *self) {
-  Expression *express = compare(self);
-  while (match_token(self, TokEq) || match_token(self, TokNe)) {
-    express = push_expression(
-        self, (Expression){LOGICAL_OP, .LogicalOp = {previous_token(self),
-                                                     express, compare(self)}});
-  }
-  return express;
-}
-
-Expression *logical_and(Parser *self) {
-  Expression *express = equality(self);
-  while (match_token(self, TokAnd)) {
-    express = push_expression(
-        self, (Expression){LOGICAL_OP, .LogicalOp = {previous_token(self),
-                                                     express, equality(self)}});
-  }
-  return express;
-}
-
-Expression *logical_or(Parser *self) {
-  Expression *express = logical_and(self);
-  while (match_token(self, TokOr)) {
-    express = push_expression(
-        self,
-        (Expression){LOGICAL_OP, .LogicalOp = {previous_token(self), express,
-                                               logical_and(self)}});
-  }
-  return express;
-}
+Expression *logical_or(Parser *self) { return binary(self, PREC_OR); }
 
 Statement if_stmt(Parser *self) {
   expect(self, TokIf);
@@ -304,8 +296,9 @@ Statement function_declaration(Parser *self) {
   expect(self, TokEnd);
   return (Statement){.type = FUNCTION_DECLARATION,
                      .FunctionDeclaration = {
-                         .name = identifier->lexeme,
-                         .name_len = identifier->lexeme_len,
+                         .name = lexeme(self, identifier),
+                         .name_len = identifier->len,
+                         .symbol = token_symbol(identifier, self->source),
                          .params = args,
                          .stmts = new_stmts,
                      }};
@@ -321,9 +314,12 @@ Statements *params(Parser *self) {
 
     *current_arg = (Statement){.type = PARAMETER,
                                .Parameter = {
-                                   .name = identifier->lexeme,
-                                   .name_len = identifier->lexeme_len,
+                                   .name = lexeme(self, identifier),
+                                   .name_len = identifier->len,
+                                   .symbol =
+                                       token_symbol(identifier, self->source),
                                }};
+    COUNT(ast_statements[PARAMETER]);
     if (is_next(self, TokRparen))
       break;
     if (expect(self, TokComma) == NULL)
@@ -382,7 +378,10 @@ Statements *stmts(Parser *self) {
   Statements *stmts_arr = arena_alloc(self->arena, sizeof(Statements));
   stmts_arr->head = curr;
   while (true) {
+    unsigned int offset = peek_token(self).offset;
     *curr = stmt(self);
+    curr->offset = offset;
+    COUNT(ast_statements[curr->type]);
     if (!((self->current < self->tokens_list_len - 1) &&
           (!is_next(self, TokElse)) && (!is_next(self, TokEnd))))
       break;
@@ -393,5 +392,9 @@ Statements *stmts(Parser *self) {
 }
 
 Node parse(Parser *self) {
+  // An empty script or one with only comments, e.g. from an empty pipe.
+  if (self->tokens_list_len == 0)
+    return (Node){.type = STMTS,
+                  .stmts = arena_alloc(self->arena, sizeof(Statements))};
   return (Node){.type = STMTS, .stmts = stmts(self)};
 };
@@ -8,14 +8,19 @@ typedef struct {
   int current;
   int tokens_list_len;
   Arena *arena;
+  Token *tokens;
+  char *source;
 } Parser;
 
 Token *advance_parser(Parser *self);
 Token *expect(Parser *self, TokenType expected_type);
 int is_next(Parser *self, TokenType expected_type);
 Token peek_token(Parser *self);
+TokenType peek_type(Parser *self);
 int match_token(Parser *self, TokenType expected_type);
 Token previous_token(Parser *self);
+char *lexeme(Parser *self, Token *token);
+Expression *binary(Parser *self, int precedence);
 Expression *term(Parser *self);
 Expression *expr(Parser *self);
 Expression *primary(Parser *self);
@@ -0,0 +1,149 @@
+#include "profile.h"
+#include "memory.h"
+#include "model.h"
+#include "tokens.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+Profile profile;
+
+void profile_start(char *source, long source_len) {
+  LineTable line_table = line_table_build(source, source_len);
+  // Line numbers start at 1.
+  profile = (Profile){
+      .enabled = true,
+      .source = source,
+      .source_len = source_len,
+      .line_table = line_table,
+      .lines = calloc(line_table.len + 1, sizeof(ProfileEntry)),
+      .functions = calloc(line_table.len + 1, sizeof(ProfileEntry)),
+      .start_ns = profile_now(),
+  };
+}
+
+unsigned long profile_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ul + now.tv_nsec;
+}
+
+unsigned int profile_line(Statement *statement) {
+  unsigned int line, column;
+  line_table_find(&profile.line_table, statement->offset, &line, &column);
+  return line;
+}
+
+void profile_enter(ProfileFrame **frames, unsigned int *len,
+                   unsigned int *cap, ProfileEntry *entry,
+                   Statement *statement) {
+  if (entry->statement == NULL)
+    entry->statement = statement;
+  entry->count++;
+  entry->active++;
+  GROW(*frames, *len, *cap);
+  (*frames)[(*len)++] = (ProfileFrame){entry, profile_now(), 0};
+}
+
+// Charges the time since the innermost frame started to its entry, and to
+// the children of the frame around it.
+void profile_exit(ProfileFrame *frames, unsigned int *len) {
+  ProfileFrame *frame = &frames[--*len];
+  unsigned long elapsed = profile_now() - frame->start_ns;
+  ProfileEntry *entry = frame->entry;
+  entry->exclusive_ns += elapsed - frame->children_ns;
+  if (--entry->active == 0)
+    entry->inclusive_ns += elapsed;
+  if (*len > 0)
+    frames[*len - 1].children_ns += elapsed;
+}
+
+void profile_statement_enter(Statement *statement) {
+  profile_enter(&profile.statements, &profile.statements_len,
+                &profile.statements_cap,
+                &profile.lines[profile_line(statement)], statement);
+}
+
+void profile_statement_exit(void) {
+  profile_exit(profile.statements, &profile.statements_len);
+}
+
+void profile_call_enter(Statement *function) {
+  profile_enter(&profile.calls, &profile.calls_len, &profile.calls_cap,
+                &profile.functions[profile_line(function)], function);
+}
+
+void profile_call_exit(void) {
+  profile_exit(profile.calls, &profile.calls_len);
+}
+
+// Most exclusive time first.
+int compare_exclusive(const void *a, const void *b) {
+  unsigned long left = (*(ProfileEntry **)a)->exclusive_ns;
+  unsigned long right = (*(ProfileEntry **)b)->exclusive_ns;
+  return (left < right) - (left > right);
+}
+
+// Fills `sorted` with the entries that ran, returning how many did.
+unsigned int profile_sorted(ProfileEntry *entries, ProfileEntry **sorted) {
+  unsigned int len = 0;
+  for (unsigned int line = 1; line <= profile.line_table.len; line++)
+    if (entries[line].count != 0)
+      sorted[len++] = &entries[line];
+  qsort(sorted, len, sizeof(ProfileEntry *), compare_exclusive);
+  return len;
+}
+
+void profile_print(void) {
+  double total_ms = (profile_now() - profile.start_ns) / 1e6;
+  ProfileEntry **sorted =
+      malloc(profile.line_table.len * sizeof(ProfileEntry *));
+  fprintf(stderr, "profile: %.3f ms in total\n\n", total_ms);
+
+  unsigned int len = profile_sorted(profile.functions, sorted);
+  fprintf(stderr, "%-24s %10s %14s %14s\n", "function", "calls",
+          "inclusive ms", "exclusive ms");
+  for (unsigned int i = 0; i < len && i < PROFILE_TOP; i++) {
+    ProfileEntry *entry = sorted[i];
+    Statement *function = entry->statement;
+    char name[64];
+    snprintf(name, sizeof(name), "%.*s (line %ld)",
+             function->FunctionDeclaration.name_len,
+             function->FunctionDeclaration.name,
+             (long)(entry - profile.functions));
+    fprintf(stderr, "%-24s %10zu %14.3f %14.3f\n", name, entry->count,
+            entry->inclusive_ns / 1e6, entry->exclusive_ns / 1e6);
+  }
+
+  len = profile_sorted(profile.lines, sorted);
+  fprintf(stderr, "\n%-6s %10s %14s %14s  %s\n", "line", "count",
+          "inclusive ms", "exclusive ms", "source");
+  for (unsigned int i = 0; i < len && i < PROFILE_TOP; i++) {
+    ProfileEntry *entry = sorted[i];
+    unsigned int line = entry - profile.lines;
+    // The line's text without indentation and newline.
+    long start = profile.line_table.starts[line - 1];
+    long end = line < profile.line_table.len
+                   ? profile.line_table.starts[line]
+                   : profile.source_len;
+    while (start < end &&
+           (profile.source[start] == ' ' || profile.source[start] == '\t'))
+      start++;
+    while (end > start && (profile.source[end - 1] == '\n' ||
+                           profile.source[end - 1] == '\r'))
+      end--;
+    fprintf(stderr, "%-6u %10zu %14.3f %14.3f  %.*s\n", line, entry->count,
+            entry->inclusive_ns / 1e6, entry->exclusive_ns / 1e6,
+            (int)(end - start), profile.source + start);
+  }
+  free(sorted);
+}
+
+void free_profile(void) {
+  free_line_table(&profile.line_table);
+  free(profile.lines);
+  free(profile.functions);
+  free(profile.statements);
+  free(profile.calls);
+  profile = (Profile){0};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "model.h"
+#include "tokens.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// --profile runs the tree walker and reads the clock around every statement
+// and every function call. A statement's time is charged to its source line
+// and a call's time to the line the function is declared on. Inclusive time
+// is all the time a line or function ran; exclusive time leaves out nested
+// statements, or for functions the functions they called. A line or
+// function that is entered again while it runs, by recursion, only counts
+// the time of its outermost entry as inclusive.
+
+// Number of lines and functions shown in the report.
+#define PROFILE_TOP 20
+
+typedef struct ProfileEntry ProfileEntry;
+typedef struct ProfileFrame ProfileFrame;
+typedef struct Profile Profile;
+
+struct ProfileEntry {
+  size_t count;
+  unsigned long inclusive_ns;
+  unsigned long exclusive_ns;
+  // Entries that haven't returned yet.
+  unsigned int active;
+  // The first statement seen on the line, or the function's declaration.
+  Statement *statement;
+};
+
+// A statement or call that is running.
+struct ProfileFrame {
+  ProfileEntry *entry;
+  unsigned long start_ns;
+  unsigned long children_ns;
+};
+
+// `lines` and `functions` are indexed by line number.
+struct Profile {
+  bool enabled;
+  char *source;
+  long source_len;
+  LineTable line_table;
+  ProfileEntry *lines;
+  ProfileEntry *functions;
+  ProfileFrame *statements;
+  unsigned int statements_len;
+  unsigned int statements_cap;
+  ProfileFrame *calls;
+  unsigned int calls_len;
+  unsigned int calls_cap;
+  unsigned long start_ns;
+};
+
+extern Profile profile;
+
+void profile_start(char *source, long source_len);
+unsigned long profile_now(void);
+unsigned int profile_line(Statement *statement);
+void profile_enter(ProfileFrame **frames, unsigned int *len,
+                   unsigned int *cap, ProfileEntry *entry,
+                   Statement *statement);
+void profile_exit(ProfileFrame *frames, unsigned int *len);
+void profile_statement_enter(Statement *statement);
+void profile_statement_exit(void);
+void profile_call_enter(Statement *function);
+void profile_call_exit(void);
+int compare_exclusive(const void *a, const void *b);
+unsigned int profile_sorted(ProfileEntry *entries, ProfileEntry **sorted);
+void profile_print(void);
+void free_profile(void);
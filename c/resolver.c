@@ -0,0 +1,286 @@
+#include "resolver.h"
+#include "memory.h"
+#include "model.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+void begin_scope(Resolver *resolver, Statements *stmts, bool frame) {
+  GROW(resolver->infos, resolver->infos_len, resolver->infos_cap);
+  resolver->infos[resolver->infos_len] = (ScopeInfo){
+      resolver->scopes_len == 0
+          ? -1
+          : (int)resolver->scopes[resolver->scopes_len - 1].id,
+      frame};
+  GROW(resolver->scopes, resolver->scopes_len, resolver->scopes_cap);
+  resolver->scopes[resolver->scopes_len++] =
+      (Scope){.stmts = stmts, .id = resolver->infos_len++, .frame = frame};
+}
+
+void end_scope(Resolver *resolver) {
+  unsigned int level = resolver->scopes_len - 1;
+  Scope *scope = &resolver->scopes[level];
+  for (unsigned int i = 0; i < scope->functions_len; i++) {
+    resolve_function(resolver, scope->functions[i]);
+    scope = &resolver->scopes[level];
+  }
+
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < resolver->pending_len; i++) {
+    PendingRead read = resolver->pending[i];
+    Expression *identifier = read.identifier;
+    bool found = false;
+    if (read.owner == level) {
+      for (unsigned int slot = 0; slot < scope->locals_len; slot++) {
+        if (scope->locals[slot].symbol == identifier->Identifier.symbol) {
+          bind(resolver, identifier, read.from, scope->id, slot);
+          found = true;
+          break;
+        }
+      }
+    }
+    if (!found && level > 0) {
+      read.owner = level - 1;
+      resolver->pending[kept++] = read;
+    }
+  }
+  resolver->pending_len = kept;
+
+  bool has_scope = scope->frame || scope->locals_len > 0 ||
+                   scope->functions_len > 0;
+  resolver->infos[scope->id].has_scope = has_scope;
+  if (scope->stmts != NULL) {
+    scope->stmts->scope_size = scope->locals_len;
+    scope->stmts->funcs_size = scope->function_slots;
+    scope->stmts->has_scope = has_scope;
+  }
+  free(scope->locals);
+  free(scope->functions);
+  resolver->scopes_len--;
+}
+
+unsigned int declare(Resolver *resolver, unsigned int symbol) {
+  Scope *scope = &resolver->scopes[resolver->scopes_len - 1];
+  GROW(scope->locals, scope->locals_len, scope->locals_cap);
+  scope->locals[scope->locals_len] = (Local){symbol};
+  return scope->locals_len++;
+}
+
+bool lookup(Resolver *resolver, unsigned int symbol, unsigned int *level,
+            unsigned int *slot) {
+  for (int i = resolver->scopes_len - 1; i >= 0; i--) {
+    Scope *scope = &resolver->scopes[i];
+    for (int j = scope->locals_len - 1; j >= 0; j--) {
+      if (scope->locals[j].symbol == symbol) {
+        *level = i;
+        *slot = j;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void bind(Resolver *resolver, Expression *identifier, unsigned int from,
+          unsigned int to, unsigned int slot) {
+  identifier->Identifier.slot = slot;
+  GROW(resolver->references, resolver->references_len,
+       resolver->references_cap);
+  resolver->references[resolver->references_len++] =
+      (Reference){identifier, from, to};
+}
+
+// The depth of a reference counts only the scopes between its use and its
+// declaration that exist at run time.
+void assign_depths(Resolver *resolver) {
+  for (unsigned int i = 0; i < resolver->references_len; i++) {
+    Reference reference = resolver->references[i];
+    int depth = 0;
+    for (int id = reference.from; id != reference.to;
+         id = resolver->infos[id].parent) {
+      if (resolver->infos[id].has_scope)
+        depth++;
+    }
+    reference.identifier->Identifier.depth = depth;
+  }
+}
+
+void resolve_assignment(Resolver *resolver, Expression *identifier) {
+  assert(identifier->type == IDENTIFIER);
+  unsigned int level, slot;
+  if (lookup(resolver, identifier->Identifier.symbol, &level, &slot)) {
+    bind(resolver, identifier,
+         resolver->scopes[resolver->scopes_len - 1].id,
+         resolver->scopes[level].id, slot);
+  } else {
+    identifier->Identifier.depth = 0;
+    identifier->Identifier.slot =
+        declare(resolver, identifier->Identifier.symbol);
+  }
+}
+
+void resolve_function(Resolver *resolver, Statement *function) {
+  begin_scope(resolver, function->FunctionDeclaration.stmts, true);
+  Statement *param = function->FunctionDeclaration.params->head;
+  while (param != NULL) {
+    declare(resolver, param->Parameter.symbol);
+    param = param->next;
+  }
+  resolve_statements(resolver, function->FunctionDeclaration.stmts);
+  end_scope(resolver);
+}
+
+void resolve_expression(Resolver *resolver, Expression *expression) {
+  switch (expression->type) {
+  case INTEGER:
+  case FLOAT:
+  case BOOL:
+  case STRING:
+    break;
+  case IDENTIFIER:;
+    unsigned int level, slot;
+    unsigned int from = resolver->scopes[resolver->scopes_len - 1].id;
+    if (lookup(resolver, expression->Identifier.symbol, &level, &slot)) {
+      bind(resolver, expression, from, resolver->scopes[level].id, slot);
+    } else {
+      expression->Identifier.depth = UNRESOLVED;
+      GROW(resolver->pending, resolver->pending_len, resolver->pending_cap);
+      resolver->pending[resolver->pending_len++] =
+          (PendingRead){expression, from, resolver->scopes_len - 1};
+    }
+    break;
+  case GROUPING:
+    resolve_expression(resolver, expression->Grouping.exp);
+    break;
+  case UNARY_OP:
+    resolve_expression(resolver, expression->UnaryOp.exp);
+    break;
+  case LOGICAL_OP:
+    resolve_expression(resolver, expression->LogicalOp.left);
+    resolve_expression(resolver, expression->LogicalOp.right);
+    break;
+  case BINARY_OP:
+  case BINARY_INT:
+  case BINARY_NUMBER:
+  case BINARY_STRING:
+    resolve_expression(resolver, expression->BinaryOp.left);
+    resolve_expression(resolver, expression->BinaryOp.right);
+    break;
+  case FUNCTION_CALL:;
+    Expression *arg = expression->FunctionCall.args->head;
+    for (int i = 0; i < expression->FunctionCall.args->length; i++) {
+      resolve_expression(resolver, arg);
+      arg = arg->next;
+    }
+    break;
+  }
+}
+
+void resolve_statement(Resolver *resolver, Statement *statement) {
+  switch (statement->type) {
+  case PRINT:
+    resolve_expression(resolver, statement->PrintStatement.value);
+    break;
+  case PRINTLN:
+    resolve_expression(resolver, statement->PrintlnStatement.value);
+    break;
+  case IF:
+    resolve_expression(resolver, statement->IfStatement.test);
+    begin_scope(resolver, statement->IfStatement.then_stmts, false);
+    resolve_statements(resolver, statement->IfStatement.then_stmts);
+    end_scope(resolver);
+    begin_scope(resolver, statement->IfStatement.else_stmts, false);
+    resolve_statements(resolver, statement->IfStatement.else_stmts);
+    end_scope(resolver);
+    break;
+  case ASSIGNMENT:
+    resolve_expression(resolver, statement->Assignment.right);
+    resolve_assignment(resolver, statement->Assignment.left);
+    break;
+  case LOCAL_ASSIGNMENT:;
+    Expression *left = &statement->LocalAssignment.left;
+    assert(left->type == IDENTIFIER);
+    resolve_expression(resolver, &statement->LocalAssignment.right);
+    Scope *scope = &resolver->scopes[resolver->scopes_len - 1];
+    left->Identifier.depth = 0;
+    left->Identifier.slot = scope->locals_len;
+    for (unsigned int i = 0; i < scope->locals_len; i++) {
+      if (scope->locals[i].symbol == left->Identifier.symbol)
+        left->Identifier.slot = i;
+    }
+    if (left->Identifier.slot == scope->locals_len)
+      declare(resolver, left->Identifier.symbol);
+    break;
+  case WHILE:
+    begin_scope(resolver, statement->While.stmts, false);
+    resolve_expression(resolver, statement->While.test);
+    resolve_statements(resolver, statement->While.stmts);
+    end_scope(resolver);
+    break;
+  case FOR:
+    begin_scope(resolver, statement->For.stmts, false);
+    resolve_expression(resolver, statement->For.start);
+    resolve_assignment(resolver, statement->For.identifier);
+    resolve_expression(resolver, statement->For.stop);
+    resolve_expression(resolver, statement->For.step);
+    resolve_statements(resolver, statement->For.stmts);
+    end_scope(resolver);
+    break;
+  case PARAMETER:
+    break;
+  case STATEMENT_FUNCTION_CALL:
+    resolve_expression(resolver, statement->FunctionCall.expr);
+    break;
+  case FUNCTION_DECLARATION:;
+    Scope *current = &resolver->scopes[resolver->scopes_len - 1];
+    // A redefinition overwrites the earlier function when it runs.
+    unsigned int slot = current->function_slots;
+    for (unsigned int i = 0; i < current->functions_len; i++) {
+      Statement *earlier = current->functions[i];
+      if (earlier->FunctionDeclaration.symbol ==
+          statement->FunctionDeclaration.symbol) {
+        slot = earlier->FunctionDeclaration.slot;
+        break;
+      }
+    }
+    if (slot == current->function_slots)
+      current->function_slots++;
+    statement->FunctionDeclaration.slot = slot;
+    GROW(current->functions, current->functions_len, current->functions_cap);
+    current->functions[current->functions_len++] = statement;
+    break;
+  case RET:
+    resolve_expression(resolver, &statement->Return.val);
+    break;
+  }
+}
+
+void resolve_statements(Resolver *resolver, Statements *stmts) {
+  Statement *current_stmt = stmts->head;
+  while (current_stmt != NULL) {
+    resolve_statement(resolver, current_stmt);
+    current_stmt = current_stmt->next;
+  }
+}
+
+void resolve(Node node) {
+  Resolver resolver = {0};
+  begin_scope(&resolver, node.type == STMTS ? node.stmts : NULL, true);
+  switch (node.type) {
+  case EXPR:
+    resolve_expression(&resolver, node.expr);
+    break;
+  case STMT:
+    resolve_statement(&resolver, node.stmt);
+    break;
+  case STMTS:
+    resolve_statements(&resolver, node.stmts);
+    break;
+  }
+  end_scope(&resolver);
+  assign_depths(&resolver);
+  free(resolver.scopes);
+  free(resolver.pending);
+  free(resolver.infos);
+  free(resolver.references);
+}
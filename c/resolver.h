@@ -0,0 +1,85 @@
+#pragma once
+
+#include "model.h"
+
+typedef struct Local Local;
+typedef struct Scope Scope;
+typedef struct PendingRead PendingRead;
+typedef struct ScopeInfo ScopeInfo;
+typedef struct Reference Reference;
+typedef struct Resolver Resolver;
+
+struct Local {
+  unsigned int symbol;
+};
+
+// A block being resolved. Function bodies declared in the block are resolved
+// when the block ends, so they can see every variable the block declares.
+// Function bodies and the program are frames and always get a scope.
+struct Scope {
+  Statements *stmts;
+  unsigned int id;
+  bool frame;
+  Local *locals;
+  unsigned int locals_len;
+  unsigned int locals_cap;
+  Statement **functions;
+  unsigned int functions_len;
+  unsigned int functions_cap;
+  // Functions declared again in the block share the slot of the first
+  // declaration, so there can be fewer slots than declarations.
+  unsigned int function_slots;
+};
+
+// Read of a name that wasn't declared yet at that point of the source, e.g.
+// inside a loop body before the assignment declaring it. `owner` is the
+// innermost open scope the read is still waiting on.
+struct PendingRead {
+  Expression *identifier;
+  unsigned int from;
+  unsigned int owner;
+};
+
+// Every scope opened so far, by id. Whether a block gets a scope at run time
+// is only known once it ends, so depths are computed after resolving.
+struct ScopeInfo {
+  int parent;
+  bool has_scope;
+};
+
+// A variable bound to a slot of scope `to`, used from scope `from`.
+struct Reference {
+  Expression *identifier;
+  unsigned int from;
+  unsigned int to;
+};
+
+struct Resolver {
+  Scope *scopes;
+  unsigned int scopes_len;
+  unsigned int scopes_cap;
+  PendingRead *pending;
+  unsigned int pending_len;
+  unsigned int pending_cap;
+  ScopeInfo *infos;
+  unsigned int infos_len;
+  unsigned int infos_cap;
+  Reference *references;
+  unsigned int references_len;
+  unsigned int references_cap;
+};
+
+void resolve(Node node);
+void begin_scope(Resolver *resolver, Statements *stmts, bool frame);
+void end_scope(Resolver *resolver);
+unsigned int declare(Resolver *resolver, unsigned int symbol);
+bool lookup(Resolver *resolver, unsigned int symbol, unsigned int *level,
+            unsigned int *slot);
+void bind(Resolver *resolver, Expression *identifier, unsigned int from,
+          unsigned int to, unsigned int slot);
+void assign_depths(Resolver *resolver);
+void resolve_assignment(Resolver *resolver, Expression *identifier);
+void resolve_function(Resolver *resolver, Statement *function);
+void resolve_expression(Resolver *resolver, Expression *expression);
+void resolve_statement(Resolver *resolver, Statement *statement);
+void resolve_statements(Resolver *resolver, Statements *stmts);
@@ -0,0 +1,99 @@
+#include "scan.h"
+#include <ctype.h>
+
+#if defined(__AVX2__) && !defined(SCAN_SCALAR)
+#include <immintrin.h>
+#define BLOCK 32
+typedef __m256i Block;
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define SPLAT(c) _mm256_set1_epi8(c)
+#define EQ(a, b) _mm256_cmpeq_epi8((a), (b))
+#define GT(a, b) _mm256_cmpgt_epi8((a), (b))
+#define OR(a, b) _mm256_or_si256((a), (b))
+#define AND(a, b) _mm256_and_si256((a), (b))
+#define MOVEMASK(a) ((unsigned int)_mm256_movemask_epi8(a))
+#elif defined(__SSE2__) && !defined(SCAN_SCALAR)
+#include <emmintrin.h>
+#define BLOCK 16
+typedef __m128i Block;
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define SPLAT(c) _mm_set1_epi8(c)
+#define EQ(a, b) _mm_cmpeq_epi8((a), (b))
+#define GT(a, b) _mm_cmpgt_epi8((a), (b))
+#define OR(a, b) _mm_or_si128((a), (b))
+#define AND(a, b) _mm_and_si128((a), (b))
+#define MOVEMASK(a) ((unsigned int)_mm_movemask_epi8(a))
+#endif
+
+#ifdef BLOCK
+// Bit i of a mask is set when byte i of the block is in the class. Bytes
+// above 0x7f compare as negative, so they are never in an ASCII range.
+#define FULL ((unsigned int)((1ull << BLOCK) - 1))
+#define IN_RANGE(b, lo, hi)                                                    \
+  AND(GT((b), SPLAT((lo) - 1)), GT(SPLAT((hi) + 1), (b)))
+#define DIGIT_MASK(b) MOVEMASK(IN_RANGE((b), '0', '9'))
+#define IDENTIFIER_MASK(b)                                                     \
+  MOVEMASK(OR(OR(IN_RANGE(OR((b), SPLAT(0x20)), 'a', 'z'),                     \
+                 IN_RANGE((b), '0', '9')),                                     \
+              EQ((b), SPLAT('_'))))
+#endif
+
+#define IS_BLANK(ch)                                                           \
+  ((ch) == ' ' || (ch) == '\t' || (ch) == '\r' || (ch) == '\n')
+
+long scan_identifier(char *source, long curr, long len) {
+#ifdef BLOCK
+  for (; curr + BLOCK <= len; curr += BLOCK) {
+    unsigned int outside = ~IDENTIFIER_MASK(LOAD(source + curr)) & FULL;
+    if (outside != 0)
+      return curr + __builtin_ctz(outside);
+  }
+#endif
+  while (curr < len && (isalnum((unsigned char)source[curr]) ||
+                         source[curr] == '_'))
+    curr++;
+  return curr;
+}
+
+long scan_digits(char *source, long curr, long len) {
+#ifdef BLOCK
+  for (; curr + BLOCK <= len; curr += BLOCK) {
+    unsigned int outside = ~DIGIT_MASK(LOAD(source + curr)) & FULL;
+    if (outside != 0)
+      return curr + __builtin_ctz(outside);
+  }
+#endif
+  while (curr < len && isdigit((unsigned char)source[curr]))
+    curr++;
+  return curr;
+}
+
+long scan_blank(char *source, long curr, long len) {
+#ifdef BLOCK
+  for (; curr + BLOCK <= len; curr += BLOCK) {
+    Block block = LOAD(source + curr);
+    unsigned int blank = MOVEMASK(
+        OR(OR(EQ(block, SPLAT(' ')), EQ(block, SPLAT('\t'))),
+           OR(EQ(block, SPLAT('\r')), EQ(block, SPLAT('\n')))));
+    unsigned int outside = ~blank & FULL;
+    if (outside != 0)
+      return curr + __builtin_ctz(outside);
+  }
+#endif
+  while (curr < len && IS_BLANK(source[curr]))
+    curr++;
+  return curr;
+}
+
+long scan_to(char *source, long curr, long len, char stop) {
+#ifdef BLOCK
+  for (; curr + BLOCK <= len; curr += BLOCK) {
+    unsigned int found = MOVEMASK(EQ(LOAD(source + curr), SPLAT(stop)));
+    if (found != 0)
+      return curr + __builtin_ctz(found);
+  }
+#endif
+  while (curr < len && source[curr] != stop)
+    curr++;
+  return curr;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Fast paths of the lexer. Each function returns the index of the first byte
+// at or after `curr` that ends the run it scans, or `len`.
+//
+// Blocks of 32 (AVX2) or 16 (SSE2) bytes are classified at once, the scalar
+// loops handle the tail and targets without either. Defining SCAN_SCALAR
+// forces the scalar loops.
+
+// Letters, digits and underscores.
+long scan_identifier(char *source, long curr, long len);
+long scan_digits(char *source, long curr, long len);
+// Spaces, tabs, carriage returns and newlines.
+long scan_blank(char *source, long curr, long len);
+// Everything up to the next `stop` byte.
+long scan_to(char *source, long curr, long len, char stop);
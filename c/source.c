@@ -0,0 +1,68 @@
+#include "source.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK (64 * 1024)
+
+Source source_open(char *filename) {
+  if (strcmp(filename, "-") == 0)
+    return source_read_stream(STDIN_FILENO);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    printf("Failed to open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    puts("Failed to get file stat");
+    exit(EXIT_FAILURE);
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    Source source = source_read_stream(fd);
+    close(fd);
+    return source;
+  }
+  char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (text == MAP_FAILED) {
+    Source source = source_read_stream(fd);
+    close(fd);
+    return source;
+  }
+  // The lexer reads the file front to back once.
+  madvise(text, st.st_size, MADV_SEQUENTIAL);
+  close(fd);
+  return (Source){text, st.st_size, true};
+}
+
+Source source_read_stream(int fd) {
+  long cap = READ_CHUNK;
+  long len = 0;
+  char *text = malloc(cap);
+  while (1) {
+    if (len == cap) {
+      cap *= 2;
+      text = realloc(text, cap);
+    }
+    ssize_t got = read(fd, text + len, cap - len);
+    if (got < 0) {
+      puts("Failed to read the script");
+      exit(EXIT_FAILURE);
+    }
+    if (got == 0)
+      break;
+    len += got;
+  }
+  return (Source){text, len, false};
+}
+
+void source_close(Source *source) {
+  if (source->mapped)
+    munmap(source->text, source->len);
+  else
+    free(source->text);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct Source Source;
+
+// Text of a script. Regular files are mapped read only and tokens point into
+// the mapping, so nothing is copied. Stdin, pipes and files that can't be
+// mapped are read into a malloc'ed buffer.
+struct Source {
+  char *text;
+  long len;
+  bool mapped;
+};
+
+// `-` reads the script from stdin.
+Source source_open(char *filename);
+Source source_read_stream(int fd);
+void source_close(Source *source);
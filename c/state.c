@@ -1,68 +1,132 @@
 #include "state.h"
+#include "buffer.h"
 #include "model.h"
+#include "output.h"
+#include "stats.h"
+#include "symbols.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include <string.h>
 
-unsigned int hash_string(char *name, unsigned int len) {
-  unsigned int res = 0;
-  for (int i = 0; i < len; i++)
-    res += i * 10 + name[i];
-  return res;
-}
+// Caches start out zeroed, so the epoch never is.
+unsigned int func_epoch = 1;
+unsigned int call_depth;
 
-void state_set(State *state, char *name, unsigned int len,
+void state_set(State *state, int depth, unsigned int slot,
                InterpretResult value) {
-  if (state->parent != NULL &&
-      state_get(state->parent, name, len).type != NONE) {
-    state_set(state->parent, name, len, value);
-    return;
-  }
-  unsigned int hashed = hash_string(name, len);
-  state->vars[hashed] = (Variable){.variable = value, .set = true};
+  COUNT(state_sets);
+  COUNT_ADD(parent_hops, depth);
+  while (depth-- > 0)
+    state = state->parent;
+  InterpretResult *var = &state->vars[slot];
+  if (var->owned || (value.type == STR && value.symbol == NO_SYMBOL))
+    buffer_store(state, var, value);
+  else
+    *var = value;
+}
+
+InterpretResult state_get(State *state, int depth, unsigned int slot) {
+  if (depth == UNRESOLVED)
+    return (InterpretResult){.type = NONE};
+  COUNT(state_gets);
+  COUNT_ADD(parent_hops, depth);
+  while (depth-- > 0)
+    state = state->parent;
+  return state->vars[slot];
+}
+
+void state_func_set(State *state, unsigned int slot, Statement *value) {
+  state->funcs[slot] = value;
+  func_epoch++;
 }
 
-InterpretResult state_get(State *state, char *name, unsigned int len) {
-  unsigned int hashed = hash_string(name, len);
-  if (!(state->vars[hashed].set)) {
-    if (state->parent == NULL) {
-      return (InterpretResult){.type = NONE};
+Statement *state_func_get(State *state, unsigned int symbol, State **owner) {
+  for (; state != NULL; state = state->parent) {
+    for (unsigned int i = 0; i < state->funcs_size; i++) {
+      Statement *func = state->funcs[i];
+      if (func != NULL && func->FunctionDeclaration.symbol == symbol) {
+        *owner = state;
+        return func;
+      }
     }
-    return state_get(state->parent, name, len);
   }
-  return state->vars[hashed].variable;
+  return NULL;
 }
 
-void state_func_set(State *state, char *name, unsigned int name_len,
-                    Statement *value) {
-  unsigned int hashed = hash_string(name, name_len);
-  state->funcs[hashed] = value;
+Statement *state_func_cached(State *state, unsigned int symbol,
+                             unsigned int argc, CallCache *cache,
+                             State **owner) {
+  COUNT(calls);
+  if (cache->epoch == func_epoch) {
+    for (unsigned int depth = cache->depth; depth > 0; depth--)
+      state = state->parent;
+    *owner = state;
+    return cache->function;
+  }
+  COUNT(call_cache_misses);
+  Statement *function = state_func_get(state, symbol, owner);
+  Symbol *name = symbol_get(symbol);
+  if (function == NULL)
+    runtime_error("Undefined function %.*s", name->len, name->name);
+  unsigned int params = function->FunctionDeclaration.params->length;
+  if (params != argc)
+    runtime_error("%.*s takes %u arguments, got %u", name->len, name->name,
+                  params, argc);
+  unsigned int depth = 0;
+  for (; state != *owner; state = state->parent)
+    depth++;
+  *cache = (CallCache){function, func_epoch, depth};
+  return function;
 }
 
-Statement *state_func_get(State *state, char *name, unsigned int name_len) {
-  unsigned int hashed = hash_string(name, name_len);
-  Statement *res = *(state->funcs + hashed);
-  if ((res == NULL) && (state->parent != NULL))
-    return state_func_get(state->parent, name, name_len);
-  return res;
+// Strings returned from the scope were copied out of its variables'
+// buffers, so nothing refers to them any more.
+void free_state(State *state, Arena *arena) {
+  if (state->funcs_size != 0)
+    func_epoch++;
+  for (unsigned int i = 0; i < state->vars_size; i++) {
+    if (state->vars[i].owned)
+      free(string_buffer(&state->vars[i]));
+  }
+  arena->pointer -= state->vars_size * sizeof(InterpretResult) +
+                    state->funcs_size * sizeof(Statement *);
 }
 
-void state_set_local(State *state, char *name, unsigned int len,
-                     InterpretResult value) {
-  unsigned int hashed = hash_string(name, len);
-  state->vars[hashed] = (Variable){.variable = value, .set = true};
+State get_new_state(State *state, Arena *arena, Statements *stmts) {
+  return state_new(state, arena, stmts->scope_size, stmts->funcs_size);
 }
 
-void free_state(State *state, Arena *arena) {
-  arena->pointer -= state->vars_size * sizeof(Variable) +
-                    state->vars_size * sizeof(Statement *);
+// Blocks that declare nothing run directly in the enclosing state; otherwise
+// the block's scope is created in `scope`. Returns the state to run in.
+State *state_enter(State *state, State *scope, Statements *stmts,
+                   Arena *arena) {
+  if (!stmts->has_scope)
+    return state;
+  *scope = get_new_state(state, arena, stmts);
+  return scope;
 }
 
-State get_new_state(State *state, Arena *arena) {
-  return state_new(state, arena);
+void state_exit(State *state, State *scope, Arena *arena) {
+  if (scope != state)
+    free_state(scope, arena);
 }
-State state_new(State *parent, Arena *arena) {
-  return (State){(Variable *)arena_alloc(arena, 2048 * sizeof(Variable)),
-                 (Statement **)arena_alloc(arena, 2048 * sizeof(Statement *)),
-                 2048, parent};
+
+State state_new(State *parent, Arena *arena, unsigned int vars_size,
+                unsigned int funcs_size) {
+  // A single allocation holds the variables followed by the functions.
+  size_t bytes =
+      vars_size * sizeof(InterpretResult) + funcs_size * sizeof(Statement *);
+  InterpretResult *vars = arena_alloc(arena, bytes);
+  // Frames are reused once a scope is freed, so clear them.
+  memset(vars, 0, bytes);
+  COUNT(scopes);
+  if (funcs_size != 0)
+    func_epoch++;
+  COUNT_ADD(frame_bytes, bytes);
+#ifdef STATS_COUNTERS
+  if (arena->pointer > stats.peak_frame_bytes)
+    stats.peak_frame_bytes = arena->pointer;
+#endif
+  return (State){vars, (Statement **)(vars + vars_size), vars_size,
+                 funcs_size, parent, call_depth};
 }
@@ -3,28 +3,42 @@
 #include "memory.h"
 #include "model.h"
 typedef struct State State;
-typedef struct Variable Variable;
 
+// Unset variables hold NONE. `depth` is the call depth of the function the
+// scope belongs to.
 struct State {
-  Variable *vars;
+  InterpretResult *vars;
   Statement **funcs;
   unsigned int vars_size;
+  unsigned int funcs_size;
   State *parent;
+  unsigned int depth;
 };
 
-struct Variable {
-  InterpretResult variable;
-  bool set;
-};
+// Bumped whenever a function is defined and whenever a scope that can hold
+// functions is created or freed. Scopes nest like the program text, so while
+// it stays the same a call site finds the same function the same number of
+// scopes up, and its CallCache can be used instead of a lookup.
+extern unsigned int func_epoch;
+// Number of function calls running. The interpreters count a call from
+// before they create its scope until they free it.
+extern unsigned int call_depth;
 
-State state_new(State *parent, Arena *arena);
-void state_set(State *state, char *name, unsigned int len,
+State state_new(State *parent, Arena *arena, unsigned int vars_size,
+                unsigned int funcs_size);
+void state_set(State *state, int depth, unsigned int slot,
                InterpretResult value);
-InterpretResult state_get(State *state, char *name, unsigned int len);
+InterpretResult state_get(State *state, int depth, unsigned int slot);
 void free_state(State *state, Arena *arena);
-State get_new_state(State *state, Arena *arena);
-void state_set_local(State *state, char *name, unsigned int len,
-                     InterpretResult value);
-void state_func_set(State *state, char *name, unsigned int name_len,
-                    Statement *value);
-Statement *state_func_get(State *state, char *name, unsigned int name_len);
+State get_new_state(State *state, Arena *arena, Statements *stmts);
+State *state_enter(State *state, State *scope, Statements *stmts,
+                   Arena *arena);
+void state_exit(State *state, State *scope, Arena *arena);
+void state_func_set(State *state, unsigned int slot, Statement *value);
+Statement *state_func_get(State *state, unsigned int symbol, State **owner);
+// Finds the function a call site with `argc` arguments calls. A function
+// that doesn't exist or takes a different number of arguments is a runtime
+// error; a cached function was already checked for the same call site.
+Statement *state_func_cached(State *state, unsigned int symbol,
+                             unsigned int argc, CallCache *cache,
+                             State **owner);
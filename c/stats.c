@@ -0,0 +1,64 @@
+#include "stats.h"
+#include "compiler.h"
+#include "flat.h"
+#include "model.h"
+#include <stdio.h>
+
+Stats stats;
+
+// Prints the nonzero entries of a per type counter array under `title`, or
+// nothing if all are zero, e.g. for the engines that didn't run.
+#define PRINT_BY_TYPE(title, counts, types, name)                              \
+  do {                                                                         \
+    size_t total = 0;                                                          \
+    for (int i = 0; i < (types); i++)                                          \
+      total += (counts)[i];                                                    \
+    if (total == 0)                                                            \
+      break;                                                                   \
+    fprintf(stderr, "%s: %zu\n", (title), total);                              \
+    for (int i = 0; i < (types); i++)                                          \
+      if ((counts)[i] != 0)                                                    \
+        fprintf(stderr, "  %s: %zu\n", name(i), (counts)[i]);                  \
+  } while (0)
+
+void stats_print(void) {
+  fprintf(stderr, "tokens: %zu\n", stats.tokens);
+  fprintf(stderr, "nodes removed by optimizer: %zu\n", stats.optimized_nodes);
+  fprintf(stderr, "peak scratch bytes: %zu\n", stats.peak_scratch_bytes);
+  fprintf(stderr, "tree AST bytes: %zu\n", stats.tree_bytes);
+  if (stats.flat_bytes != 0)
+    fprintf(stderr, "flat AST bytes: %zu\n", stats.flat_bytes);
+  fprintf(stderr, "main arena bytes: %zu\n", stats.main_arena_bytes);
+  fprintf(stderr, "output writes: %zu\n", stats.output_writes);
+#ifdef STATS_COUNTERS
+  fprintf(stderr, "escaped string bytes: %zu\n", stats.escaped_bytes);
+  fprintf(stderr, "quickened nodes: %zu\n", stats.quickened_nodes);
+  fprintf(stderr, "deoptimized nodes: %zu\n", stats.deoptimized_nodes);
+  fprintf(stderr, "scopes: %zu\n", stats.scopes);
+  fprintf(stderr, "frame bytes: %zu\n", stats.frame_bytes);
+  fprintf(stderr, "peak frame bytes: %zu\n", stats.peak_frame_bytes);
+  fprintf(stderr, "calls: %zu\n", stats.calls);
+  fprintf(stderr, "call cache misses: %zu\n", stats.call_cache_misses);
+  if (stats.evaluated_nodes != 0)
+    fprintf(stderr, "evaluated nodes: %zu\n", stats.evaluated_nodes);
+  fprintf(stderr, "state_get calls: %zu\n", stats.state_gets);
+  fprintf(stderr, "state_set calls: %zu\n", stats.state_sets);
+  fprintf(stderr, "parent scope hops: %zu\n", stats.parent_hops);
+  PRINT_BY_TYPE("parsed expressions", stats.ast_expressions,
+                EXPRESSION_TYPES, expression_type_string);
+  PRINT_BY_TYPE("parsed statements", stats.ast_statements, STATEMENT_TYPES,
+                statement_type_string);
+  PRINT_BY_TYPE("evaluated expressions", stats.evaluated_expressions,
+                EXPRESSION_TYPES, expression_type_string);
+  PRINT_BY_TYPE("evaluated statements", stats.evaluated_statements,
+                STATEMENT_TYPES, statement_type_string);
+  PRINT_BY_TYPE("evaluated flat nodes", stats.flat_evaluated, FLAT_KINDS,
+                flat_kind_string);
+  PRINT_BY_TYPE("executed instructions", stats.instructions, OPCODES,
+                opcode_string);
+#else
+  fprintf(stderr, "scopes, frame bytes, calls and counts by node type and "
+                  "opcode need a build with -DSTATS_COUNTERS (make "
+                  "run-c-stats)\n");
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "compiler.h"
+#include "flat.h"
+#include "model.h"
+#include <stddef.h>
+
+// Counters on the hot paths of the interpreters, such as evaluations by node
+// type or variable accesses, are only compiled in when STATS_COUNTERS is
+// defined (`make run-c-stats`). Otherwise COUNT() and COUNT_ADD() expand to
+// nothing and --stats prints the cheaper counters that every build keeps.
+#ifdef STATS_COUNTERS
+#define COUNT(counter) (stats.counter++)
+#define COUNT_ADD(counter, n) (stats.counter += (n))
+#else
+#define COUNT(counter) ((void)0)
+#define COUNT_ADD(counter, n) ((void)0)
+#endif
+
+typedef struct Stats Stats;
+
+// Counters reported by --stats.
+struct Stats {
+  size_t tokens;
+  size_t optimized_nodes;
+  size_t peak_scratch_bytes;
+  size_t tree_bytes;
+  size_t flat_bytes;
+  // Everything the program allocated in the main arena. Nothing in it is
+  // freed, so this is also its high-water mark.
+  size_t main_arena_bytes;
+  size_t output_writes;
+#ifdef STATS_COUNTERS
+  size_t escaped_bytes;
+  size_t quickened_nodes;
+  size_t deoptimized_nodes;
+  size_t scopes;
+  size_t frame_bytes;
+  size_t peak_frame_bytes;
+  size_t calls;
+  size_t call_cache_misses;
+  // Expressions and statements the tree walker evaluated.
+  size_t evaluated_nodes;
+  size_t ast_expressions[EXPRESSION_TYPES];
+  size_t ast_statements[STATEMENT_TYPES];
+  size_t evaluated_expressions[EXPRESSION_TYPES];
+  size_t evaluated_statements[STATEMENT_TYPES];
+  size_t flat_evaluated[FLAT_KINDS];
+  size_t instructions[OPCODES];
+  size_t state_gets;
+  size_t state_sets;
+  // Scopes walked up by state_get() and state_set() to reach a variable.
+  size_t parent_hops;
+#endif
+};
+
+extern Stats stats;
+
+void stats_print(void);
@@ -0,0 +1,68 @@
+#include "symbols.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SymbolTable symbol_table;
+
+// FNV-1a.
+unsigned int hash_string(char *name, unsigned int len) {
+  unsigned int hash = 2166136261u;
+  for (unsigned int i = 0; i < len; i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void grow_buckets(SymbolTable *table) {
+  unsigned int cap = table->buckets_cap == 0 ? 256 : table->buckets_cap * 2;
+  unsigned int *buckets = malloc(cap * sizeof(unsigned int));
+  memset(buckets, 0, cap * sizeof(unsigned int));
+  for (unsigned int id = 1; id < table->symbols_len; id++) {
+    unsigned int i = table->symbols[id].hash & (cap - 1);
+    while (buckets[i] != NO_SYMBOL)
+      i = (i + 1) & (cap - 1);
+    buckets[i] = id;
+  }
+  free(table->buckets);
+  table->buckets = buckets;
+  table->buckets_cap = cap;
+}
+
+unsigned int intern(char *name, unsigned int len) {
+  SymbolTable *table = &symbol_table;
+  if (table->symbols_len == 0) {
+    GROW(table->symbols, table->symbols_len, table->symbols_cap);
+    table->symbols[table->symbols_len++] = (Symbol){0};
+  }
+  // Keep the table at most half full.
+  if (2 * (table->symbols_len + 1) > table->buckets_cap)
+    grow_buckets(table);
+  unsigned int hash = hash_string(name, len);
+  unsigned int mask = table->buckets_cap - 1;
+  unsigned int i = hash & mask;
+  for (; table->buckets[i] != NO_SYMBOL; i = (i + 1) & mask) {
+    Symbol *symbol = &table->symbols[table->buckets[i]];
+    if (symbol->hash == hash && symbol->len == len &&
+        memcmp(symbol->name, name, len) == 0)
+      return table->buckets[i];
+  }
+  if (table->symbols_len == SYMBOLS_MAX) {
+    puts("Too many symbols");
+    exit(EXIT_FAILURE);
+  }
+  GROW(table->symbols, table->symbols_len, table->symbols_cap);
+  table->symbols[table->symbols_len] = (Symbol){name, len, hash};
+  table->buckets[i] = table->symbols_len;
+  return table->symbols_len++;
+}
+
+Symbol *symbol_get(unsigned int id) { return &symbol_table.symbols[id]; }
+
+void free_symbols(void) {
+  free(symbol_table.symbols);
+  free(symbol_table.buckets);
+  symbol_table = (SymbolTable){0};
+}
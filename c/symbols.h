@@ -0,0 +1,35 @@
+#pragma once
+
+// Identifiers and string literals are interned while tokenizing. Every
+// distinct spelling gets a dense id, so names and literals compare as
+// integers from the parser on. Ids start at 1, so zero initialized values
+// have no symbol.
+#define NO_SYMBOL 0
+// Values keep the symbol of a string in 24 bits.
+#define SYMBOLS_MAX (1 << 24)
+
+typedef struct Symbol Symbol;
+typedef struct SymbolTable SymbolTable;
+
+struct Symbol {
+  char *name;
+  unsigned int len;
+  unsigned int hash;
+};
+
+// Symbols are stored by id. `buckets` is an open addressing table of ids,
+// with NO_SYMBOL marking an empty bucket.
+struct SymbolTable {
+  Symbol *symbols;
+  unsigned int symbols_len;
+  unsigned int symbols_cap;
+  unsigned int *buckets;
+  unsigned int buckets_cap;
+};
+
+extern SymbolTable symbol_table;
+
+unsigned int hash_string(char *name, unsigned int len);
+unsigned int intern(char *name, unsigned int len);
+Symbol *symbol_get(unsigned int id);
+void free_symbols(void);
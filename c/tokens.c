@@ -1,6 +1,10 @@
 #include "tokens.h"
+#include "memory.h"
+#include "scan.h"
+#include "symbols.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 char *token_type_string(TokenType token_type) {
@@ -101,58 +105,130 @@ char *token_type_string(TokenType token_type) {
     return ("TokRet");
   case (TokLocal):
     return ("TokLocal");
+  case (TokEof):
+    return ("TokEof");
   }
   assert("Failed to find a keyword");
   return "shouldn't get as a return";
 }
 
-void token_print(Token *token) {
-  printf("(%s, %.*s, on line %d starting at %d)\n",
-         token_type_string(token->token_type), token->lexeme_len, token->lexeme,
-         token->line, token->position);
+void token_print(Token *token, char *source, LineTable *lines) {
+  unsigned int line, column;
+  line_table_find(lines, token->offset, &line, &column);
+  printf("(%s, %.*s, on line %u starting at %u)\n",
+         token_type_string(token->token_type), token->len,
+         source + token->offset, line, column);
 }
 
-TokenType keywords(char *lexeme, int lexeme_size) {
+#define KEYWORD(word, type)                                                    \
+  if (memcmp(lexeme, word, sizeof(word) - 1) == 0)                             \
+    return type;                                                               \
+  break;
 
-  if ((strncmp("if", lexeme, lexeme_size) == 0) &&
-      (strlen("if") == lexeme_size)) {
-    return TokIf;
-  } else if (strncmp("else", lexeme, lexeme_size) == 0) {
-    return TokElse;
-  } else if (strncmp("then", lexeme, lexeme_size) == 0) {
-    return TokThen;
-  } else if (strncmp("true", lexeme, lexeme_size) == 0) {
-    return TokTrue;
-  } else if (strncmp("false", lexeme, lexeme_size) == 0) {
-    return TokFalse;
-  } else if (strcmp("and", lexeme) == 0) {
-    return TokAnd;
-  } else if (strncmp("or", lexeme, lexeme_size) == 0) {
-    return TokOr;
-  } else if (strncmp("while", lexeme, lexeme_size) == 0) {
-    return TokWhile;
-  } else if ((strncmp("do", lexeme, lexeme_size) == 0) &&
-             (strlen("do") == lexeme_size)) {
-    return TokDo;
-  } else if (strncmp("for", lexeme, lexeme_size) == 0) {
-    return TokFor;
-  } else if (strncmp("func", lexeme, lexeme_size) == 0) {
-    return TokFunc;
-  } else if (strcmp("null", lexeme) == 0) {
-    return TokNull;
-  } else if (strncmp("end", lexeme, lexeme_size) == 0) {
-    return TokEnd;
-  } else if (strncmp("print", lexeme, lexeme_size) == 0) {
-    return TokPrint;
-  } else if (strncmp("println", lexeme, lexeme_size) == 0) {
-    return TokPrintln;
-  } else if (strncmp("ret", lexeme, lexeme_size) == 0) {
-    return TokRet;
+// Keywords are told apart by their length and first character, so every
+// identifier is compared against at most one keyword, over its exact length.
+TokenType keywords(char *lexeme, int lexeme_size) {
+  switch (lexeme_size) {
+  case 2:
+    switch (lexeme[0]) {
+    case 'i':
+      KEYWORD("if", TokIf);
+    case 'o':
+      KEYWORD("or", TokOr);
+    case 'd':
+      KEYWORD("do", TokDo);
+    }
+    break;
+  case 3:
+    switch (lexeme[0]) {
+    case 'a':
+      KEYWORD("and", TokAnd);
+    case 'f':
+      KEYWORD("for", TokFor);
+    case 'e':
+      KEYWORD("end", TokEnd);
+    case 'r':
+      KEYWORD("ret", TokRet);
+    }
+    break;
+  case 4:
+    switch (lexeme[0]) {
+    case 'e':
+      KEYWORD("else", TokElse);
+    case 't':
+      if (lexeme[1] == 'h') {
+        KEYWORD("then", TokThen);
+      }
+      KEYWORD("true", TokTrue);
+    case 'f':
+      KEYWORD("func", TokFunc);
+    case 'n':
+      KEYWORD("null", TokNull);
+    }
+    break;
+  case 5:
+    switch (lexeme[0]) {
+    case 'f':
+      KEYWORD("false", TokFalse);
+    case 'w':
+      KEYWORD("while", TokWhile);
+    case 'p':
+      KEYWORD("print", TokPrint);
+    case 'l':
+      KEYWORD("local", TokLocal);
+    }
+    break;
+  case 7:
+    KEYWORD("println", TokPrintln);
   }
   return TokIdentifier;
 }
 
-Token token_init(TokenType token_type, char *lexeme, unsigned int line,
-                 unsigned int lexeme_len, unsigned int position) {
-  return (Token){token_type, lexeme, line, lexeme_len, position};
+#undef KEYWORD
+
+// Lexemes point into the source, which isn't terminated after the last one.
+void token_copy(Token *token, char *source, char *buffer) {
+  memcpy(buffer, source + token->offset, token->len);
+  buffer[token->len] = '\0';
+}
+
+// Interned spelling of identifiers and string literals (without quotes),
+// NO_SYMBOL for other tokens.
+unsigned int token_symbol(Token *token, char *source) {
+  char *lexeme = source + token->offset;
+  if (token->token_type == TokIdentifier)
+    return intern(lexeme, token->len);
+  if (token->token_type == TokString)
+    return intern(lexeme + 1, token->len - 2);
+  return NO_SYMBOL;
+}
+
+LineTable line_table_build(char *source, long len) {
+  LineTable lines = {0};
+  GROW(lines.starts, lines.len, lines.cap);
+  lines.starts[lines.len++] = 0;
+  for (long curr = scan_to(source, 0, len, '\n'); curr < len;
+       curr = scan_to(source, curr + 1, len, '\n')) {
+    GROW(lines.starts, lines.len, lines.cap);
+    lines.starts[lines.len++] = curr + 1;
+  }
+  return lines;
+}
+
+// Lines and columns start at 1.
+void line_table_find(LineTable *lines, unsigned int offset, unsigned int *line,
+                     unsigned int *column) {
+  unsigned int low = 0;
+  unsigned int high = lines->len;
+  while (high - low > 1) {
+    unsigned int middle = low + (high - low) / 2;
+    if (lines->starts[middle] <= offset)
+      low = middle;
+    else
+      high = middle;
+  }
+  *line = low + 1;
+  *column = offset - lines->starts[low] + 1;
 }
+
+void free_line_table(LineTable *lines) { free(lines->starts); }
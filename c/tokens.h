@@ -49,19 +49,36 @@ typedef enum {
   TokPrintln,
   TokRet,
   TokLocal,
+  // Returned by the parser when peeking past the last token.
+  TokEof,
 } TokenType;
 
+// Tokens keep where their lexeme starts in the source instead of a pointer.
+// Lines and columns are only needed for messages, so they are looked up in a
+// LineTable built on demand.
 typedef struct {
-  TokenType token_type;
-  char *lexeme;
-  unsigned int line;
-  unsigned int lexeme_len;
-  unsigned int position;
-} Token __attribute__((aligned(8)));
+  unsigned int offset;
+  unsigned int len : 24;
+  TokenType token_type : 8;
+} Token;
+
+#define TOKEN_LEN_MAX ((1 << 24) - 1)
+
+// Offsets of the first byte of every line of a source.
+typedef struct {
+  unsigned int *starts;
+  unsigned int len;
+  unsigned int cap;
+} LineTable;
 
-Token token_init(TokenType token_type, char *lexeme, unsigned int line,
-                 unsigned int lexeme_len, unsigned int position);
 TokenType keywords(char *lexeme, int lexeme_size);
+void token_copy(Token *token, char *source, char *buffer);
+unsigned int token_symbol(Token *token, char *source);
 
-void token_print(Token *token);
+void token_print(Token *token, char *source, LineTable *lines);
 char *token_type_string(TokenType token_type);
+
+LineTable line_table_build(char *source, long len);
+void line_table_find(LineTable *lines, unsigned int offset, unsigned int *line,
+                     unsigned int *column);
+void free_line_table(LineTable *lines);
@@ -0,0 +1,428 @@
+#include "vm.h"
+#include "buffer.h"
+#include "compiler.h"
+#include "interpreter.h"
+#include "memory.h"
+#include "model.h"
+#include "output.h"
+#include "state.h"
+#include "stats.h"
+#include "tokens.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define COMPUTED_GOTO
+#endif
+
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK(distance) (sp[-1 - (distance)])
+
+// Mixed integer and double operands are computed as doubles.
+#define ARITHMETIC(token, operator)                                            \
+  do {                                                                         \
+    InterpretResult right = POP();                                             \
+    InterpretResult *left = &PEEK(0);                                          \
+    if (left->type == NUMBER && right.type == NUMBER)                          \
+      left->Number.value = left->Number.value operator right.Number.value;     \
+    else if (IS_NUMERIC(*left) && IS_NUMERIC(right))                           \
+      *left = (InterpretResult){.type = NUMBER,                                \
+                                .Number.value = AS_DOUBLE(*left)               \
+                                    operator AS_DOUBLE(right)};                \
+    else                                                                       \
+      *left = binary_op(token, *left, right, &scratch);                        \
+  } while (0)
+
+// Integers stay integers, wrapping around on overflow.
+#define INTEGER_ARITHMETIC(token, operator)                                    \
+  do {                                                                         \
+    InterpretResult right = POP();                                             \
+    InterpretResult *left = &PEEK(0);                                          \
+    if (left->type == INT && right.type == INT)                                \
+      left->Int.value = WRAP(left->Int.value, operator, right.Int.value);      \
+    else if (left->type == NUMBER && right.type == NUMBER)                     \
+      left->Number.value = left->Number.value operator right.Number.value;     \
+    else if (IS_NUMERIC(*left) && IS_NUMERIC(right))                           \
+      *left = (InterpretResult){.type = NUMBER,                                \
+                                .Number.value = AS_DOUBLE(*left)               \
+                                    operator AS_DOUBLE(right)};                \
+    else                                                                       \
+      *left = binary_op(token, *left, right, &scratch);                        \
+  } while (0)
+
+#define COMPARISON(token, operator)                                            \
+  do {                                                                         \
+    InterpretResult right = POP();                                             \
+    InterpretResult *left = &PEEK(0);                                          \
+    if (left->type == INT && right.type == INT)                                \
+      *left = (InterpretResult){                                               \
+          .type = BOOLEAN,                                                     \
+          .Bool.value = left->Int.value operator right.Int.value};             \
+    else if (left->type == NUMBER && right.type == NUMBER)                     \
+      *left = (InterpretResult){                                               \
+          .type = BOOLEAN,                                                     \
+          .Bool.value = left->Number.value operator right.Number.value};       \
+    else if (IS_NUMERIC(*left) && IS_NUMERIC(right))                           \
+      *left = (InterpretResult){                                               \
+          .type = BOOLEAN,                                                     \
+          .Bool.value = AS_DOUBLE(*left) operator AS_DOUBLE(right)};           \
+    else                                                                       \
+      *left = binary_op(token, *left, right, &scratch);                        \
+  } while (0)
+
+#define GENERIC(token)                                                         \
+  do {                                                                         \
+    InterpretResult right = POP();                                             \
+    PEEK(0) = binary_op(token, PEEK(0), right, &scratch);                      \
+  } while (0)
+
+bool is_truthy(InterpretResult *value) {
+  switch (value->type) {
+  case BOOLEAN:
+    return value->Bool.value;
+  case INT:
+    return value->Int.value != 0;
+  case NUMBER:
+    return value->Number.value != 0.0;
+  case STR:
+    return value->len != 0;
+  case NONE:
+    return false;
+  }
+  return false;
+}
+
+// Loops over integers compare exactly; a double anywhere makes the loop
+// compare doubles.
+bool for_done(InterpretResult *start, InterpretResult *stop,
+              InterpretResult *current) {
+  if (start->type == INT && stop->type == INT && current->type == INT)
+    return (start->Int.value <= stop->Int.value &&
+            current->Int.value >= stop->Int.value) ||
+           (start->Int.value >= stop->Int.value &&
+            current->Int.value <= stop->Int.value);
+  double from = AS_DOUBLE(*start);
+  double to = AS_DOUBLE(*stop);
+  double at = AS_DOUBLE(*current);
+  return (from <= to && at >= to) || (from >= to && at <= to);
+}
+
+// An integer counter with an integer step stays an integer.
+void for_step(InterpretResult *current, InterpretResult *step) {
+  if (current->type == INT && step->type == INT)
+    current->Int.value = WRAP(current->Int.value, +, step->Int.value);
+  else
+    *current = (InterpretResult){
+        .type = NUMBER, .Number.value = AS_DOUBLE(*current) + AS_DOUBLE(*step)};
+}
+
+InterpretResult vm_run(Chunk *chunk, Arena *arena) {
+  Arena hashmap_arena = new_arena();
+  Arena scratch = new_arena();
+  InterpretResult *stack = reserve(STACK_MAX * sizeof(InterpretResult));
+  Frame *frames = reserve(FRAMES_MAX * sizeof(Frame));
+  State *scopes = reserve(SCOPES_MAX * sizeof(State));
+
+  InterpretResult *sp = stack;
+  Frame *frame = frames;
+  frame->scratch_mark = 0;
+  State *scope = scopes;
+  *scope = (State){0};
+  Instruction *ip = chunk->code;
+  Instruction instruction;
+  InterpretResult result = {.type = NONE};
+
+#ifdef COMPUTED_GOTO
+  static void *dispatch_table[] = {
+      [OP_PUSH] = &&TARGET_OP_PUSH,
+      [OP_POP] = &&TARGET_OP_POP,
+      [OP_DUP] = &&TARGET_OP_DUP,
+      [OP_LOAD_LOCAL] = &&TARGET_OP_LOAD_LOCAL,
+      [OP_LOAD_VAR] = &&TARGET_OP_LOAD_VAR,
+      [OP_STORE_LOCAL] = &&TARGET_OP_STORE_LOCAL,
+      [OP_STORE_VAR] = &&TARGET_OP_STORE_VAR,
+      [OP_ADD] = &&TARGET_OP_ADD,
+      [OP_SUB] = &&TARGET_OP_SUB,
+      [OP_MUL] = &&TARGET_OP_MUL,
+      [OP_DIV] = &&TARGET_OP_DIV,
+      [OP_MOD] = &&TARGET_OP_MOD,
+      [OP_EXP] = &&TARGET_OP_EXP,
+      [OP_EQ] = &&TARGET_OP_EQ,
+      [OP_NE] = &&TARGET_OP_NE,
+      [OP_LT] = &&TARGET_OP_LT,
+      [OP_GT] = &&TARGET_OP_GT,
+      [OP_LE] = &&TARGET_OP_LE,
+      [OP_GE] = &&TARGET_OP_GE,
+      [OP_NEG] = &&TARGET_OP_NEG,
+      [OP_NOT] = &&TARGET_OP_NOT,
+      [OP_AND] = &&TARGET_OP_AND,
+      [OP_OR] = &&TARGET_OP_OR,
+      [OP_JMP] = &&TARGET_OP_JMP,
+      [OP_JMPZ] = &&TARGET_OP_JMPZ,
+      [OP_ENTER_SCOPE] = &&TARGET_OP_ENTER_SCOPE,
+      [OP_EXIT_SCOPE] = &&TARGET_OP_EXIT_SCOPE,
+      [OP_FOR_PREP] = &&TARGET_OP_FOR_PREP,
+      [OP_FOR_LOOP] = &&TARGET_OP_FOR_LOOP,
+      [OP_DEFINE_FUNC] = &&TARGET_OP_DEFINE_FUNC,
+      [OP_CALL] = &&TARGET_OP_CALL,
+      [OP_RTS] = &&TARGET_OP_RTS,
+      [OP_PRINT] = &&TARGET_OP_PRINT,
+      [OP_PRINTLN] = &&TARGET_OP_PRINTLN,
+      [OP_HALT] = &&TARGET_OP_HALT,
+  };
+#define TARGET(op) TARGET_##op:
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    instruction = *ip++;                                                       \
+    COUNT(instructions[OPCODE(instruction)]);                                  \
+    goto *dispatch_table[OPCODE(instruction)];                                 \
+  } while (0)
+#else
+#define TARGET(op) case op:
+#define DISPATCH() continue
+#endif
+
+#ifdef COMPUTED_GOTO
+  DISPATCH();
+#endif
+  while (1) {
+    instruction = *ip++;
+    COUNT(instructions[OPCODE(instruction)]);
+    switch (OPCODE(instruction)) {
+      TARGET(OP_PUSH) {
+        PUSH(chunk->constants[OPERAND(instruction)]);
+        DISPATCH();
+      }
+      TARGET(OP_POP) {
+        sp--;
+        DISPATCH();
+      }
+      TARGET(OP_DUP) {
+        *sp = PEEK(0);
+        sp++;
+        DISPATCH();
+      }
+      TARGET(OP_LOAD_LOCAL) {
+        PUSH(state_get(scope, 0, OPERAND(instruction)));
+        DISPATCH();
+      }
+      TARGET(OP_LOAD_VAR) {
+        unsigned int operand = OPERAND(instruction);
+        PUSH(state_get(scope, VARIABLE_DEPTH(operand), VARIABLE_SLOT(operand)));
+        DISPATCH();
+      }
+      TARGET(OP_STORE_LOCAL) {
+        state_set(scope, 0, OPERAND(instruction), POP());
+        DISPATCH();
+      }
+      TARGET(OP_STORE_VAR) {
+        unsigned int operand = OPERAND(instruction);
+        state_set(scope, VARIABLE_DEPTH(operand), VARIABLE_SLOT(operand),
+                  POP());
+        DISPATCH();
+      }
+      TARGET(OP_ADD) {
+        INTEGER_ARITHMETIC(TokPlus, +);
+        DISPATCH();
+      }
+      TARGET(OP_SUB) {
+        INTEGER_ARITHMETIC(TokMinus, -);
+        DISPATCH();
+      }
+      TARGET(OP_MUL) {
+        INTEGER_ARITHMETIC(TokStar, *);
+        DISPATCH();
+      }
+      TARGET(OP_DIV) {
+        ARITHMETIC(TokSlash, /);
+        DISPATCH();
+      }
+      TARGET(OP_MOD) {
+        if (PEEK(0).type == INT && PEEK(1).type == INT) {
+          sp--;
+          PEEK(0).Int.value = integer_mod(PEEK(0).Int.value, sp->Int.value);
+          DISPATCH();
+        }
+        GENERIC(TokMod);
+        DISPATCH();
+      }
+      TARGET(OP_EXP) {
+        GENERIC(TokCaret);
+        DISPATCH();
+      }
+      TARGET(OP_EQ) {
+        COMPARISON(TokEq, ==);
+        DISPATCH();
+      }
+      TARGET(OP_NE) {
+        COMPARISON(TokNe, !=);
+        DISPATCH();
+      }
+      TARGET(OP_LT) {
+        COMPARISON(TokLt, <);
+        DISPATCH();
+      }
+      TARGET(OP_GT) {
+        COMPARISON(TokGt, >);
+        DISPATCH();
+      }
+      TARGET(OP_LE) {
+        COMPARISON(TokLe, <=);
+        DISPATCH();
+      }
+      TARGET(OP_GE) {
+        COMPARISON(TokGe, >=);
+        DISPATCH();
+      }
+      TARGET(OP_NEG) {
+        if (PEEK(0).type == INT)
+          PEEK(0).Int.value = WRAP(0, -, PEEK(0).Int.value);
+        else if (PEEK(0).type == NUMBER)
+          PEEK(0).Number.value = -PEEK(0).Number.value;
+        DISPATCH();
+      }
+      TARGET(OP_NOT) {
+        PEEK(0) = (InterpretResult){.type = BOOLEAN,
+                                    .Bool.value = !is_truthy(&PEEK(0))};
+        DISPATCH();
+      }
+      TARGET(OP_AND) {
+        if (!is_truthy(&PEEK(0))) {
+          PEEK(0) = (InterpretResult){.type = BOOLEAN, .Bool.value = false};
+          ip = chunk->code + OPERAND(instruction);
+        } else {
+          sp--;
+        }
+        DISPATCH();
+      }
+      TARGET(OP_OR) {
+        if (is_truthy(&PEEK(0))) {
+          PEEK(0) = (InterpretResult){.type = BOOLEAN, .Bool.value = true};
+          ip = chunk->code + OPERAND(instruction);
+        } else {
+          sp--;
+        }
+        DISPATCH();
+      }
+      // Jumps and loop back-edges are only emitted between statements, where
+      // the frame holds no temporaries: everything it allocated in scratch
+      // since the call is either stored (and escaped) or dead.
+      TARGET(OP_JMP) {
+        scratch_release(&scratch, frame->scratch_mark);
+        ip = chunk->code + OPERAND(instruction);
+        DISPATCH();
+      }
+      TARGET(OP_JMPZ) {
+        sp--;
+        if (!is_truthy(sp))
+          ip = chunk->code + OPERAND(instruction);
+        DISPATCH();
+      }
+      TARGET(OP_ENTER_SCOPE) {
+        if (scope + 1 == scopes + SCOPES_MAX) {
+          runtime_error("Too many nested scopes");
+        }
+        scope[1] = state_new(scope, &hashmap_arena,
+                             SCOPE_VARS(OPERAND(instruction)),
+                             SCOPE_FUNCS(OPERAND(instruction)));
+        scope++;
+        DISPATCH();
+      }
+      TARGET(OP_EXIT_SCOPE) {
+        free_state(scope, &hashmap_arena);
+        scope--;
+        DISPATCH();
+      }
+      TARGET(OP_FOR_PREP) {
+        *sp = PEEK(2);
+        sp++;
+        if (for_done(&PEEK(3), &PEEK(2), &PEEK(0))) {
+          sp -= 4;
+          ip = chunk->code + OPERAND(instruction);
+        }
+        DISPATCH();
+      }
+      TARGET(OP_FOR_LOOP) {
+        for_step(&PEEK(0), &PEEK(1));
+        if (for_done(&PEEK(3), &PEEK(2), &PEEK(0))) {
+          PEEK(3) = PEEK(0);
+          sp -= 3;
+        } else {
+          scratch_release(&scratch, frame->scratch_mark);
+          ip = chunk->code + OPERAND(instruction);
+        }
+        DISPATCH();
+      }
+      TARGET(OP_DEFINE_FUNC) {
+        Statement *function = chunk->functions[OPERAND(instruction)];
+        state_func_set(scope, function->FunctionDeclaration.slot, function);
+        DISPATCH();
+      }
+      TARGET(OP_CALL) {
+        CallSite *call = &chunk->calls[OPERAND(instruction)];
+        State *owner;
+        Statement *function = state_func_cached(scope, call->symbol,
+                                                call->argc, &call->cache,
+                                                &owner);
+        if (frame + 1 == frames + FRAMES_MAX ||
+            scope + 1 == scopes + SCOPES_MAX || sp >= stack + STACK_MAX / 2) {
+          runtime_error("Stack overflow");
+        }
+        call_depth++;
+        scope[1] = get_new_state(owner, &hashmap_arena,
+                                 function->FunctionDeclaration.stmts);
+        scope++;
+        InterpretResult *args = sp - call->argc;
+        for (unsigned int i = 0; i < call->argc; i++)
+          state_set(scope, 0, i, args[i]);
+        sp = args;
+        *frame = (Frame){ip, scope - 1, sp, frame->scratch_mark};
+        frame++;
+        frame->scratch_mark = scratch.pointer;
+        ip = chunk->code + function->FunctionDeclaration.entry;
+        DISPATCH();
+      }
+      TARGET(OP_RTS) {
+        InterpretResult value = buffer_detach(POP(), &scratch);
+        if (frame == frames) {
+          result = value;
+          goto halt;
+        }
+        frame--;
+        while (scope > frame->scope) {
+          free_state(scope, &hashmap_arena);
+          scope--;
+        }
+        call_depth--;
+        sp = frame->sp;
+        ip = frame->return_ip;
+        PUSH(value);
+        DISPATCH();
+      }
+      TARGET(OP_PRINT) {
+        InterpretResult value = POP();
+        interpret_result_print(&value, "");
+        DISPATCH();
+      }
+      TARGET(OP_PRINTLN) {
+        InterpretResult value = POP();
+        interpret_result_print(&value, "\n");
+        DISPATCH();
+      }
+      TARGET(OP_HALT) { goto halt; }
+    }
+  }
+
+halt:
+  result = escape_value(result, &scratch, arena);
+  scratch_release(&scratch, 0);
+  munmap(stack, STACK_MAX * sizeof(InterpretResult));
+  munmap(frames, FRAMES_MAX * sizeof(Frame));
+  munmap(scopes, SCOPES_MAX * sizeof(State));
+  munmap(hashmap_arena.memory, ARENA_SIZE);
+  munmap(scratch.memory, ARENA_SIZE);
+  return result;
+}
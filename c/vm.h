@@ -0,0 +1,32 @@
+#pragma once
+
+#include "compiler.h"
+#include "memory.h"
+#include "model.h"
+#include "state.h"
+#include <stdbool.h>
+
+// The stacks are reserved like arenas and only take memory as deep as a
+// program recurses. A call takes one frame and at least one scope, so there
+// is room for nested blocks and for the temporaries of the calling
+// expressions. The tree walker runs out of C stack long before this depth.
+#define FRAMES_MAX (1 << 20)
+#define STACK_MAX (FRAMES_MAX * 4)
+#define SCOPES_MAX (FRAMES_MAX * 4)
+
+typedef struct Frame Frame;
+
+// `scratch_mark` is where the function's temporaries start in the scratch
+// arena; it is kept in the slot above the saved return frames.
+struct Frame {
+  Instruction *return_ip;
+  State *scope;
+  InterpretResult *sp;
+  size_t scratch_mark;
+};
+
+InterpretResult vm_run(Chunk *chunk, Arena *arena);
+bool is_truthy(InterpretResult *value);
+bool for_done(InterpretResult *start, InterpretResult *stop,
+              InterpretResult *current);
+void for_step(InterpretResult *current, InterpretResult *step);